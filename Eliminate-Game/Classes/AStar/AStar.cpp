@@ -1,4 +1,8 @@
 ﻿#include "AStar.h"
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <new>
 #include <algorithm>
 
 static const int STEP_VALUE = 10;
@@ -10,13 +14,15 @@ AStar::AStar()
 	, height_(0)
 	, step_value_(STEP_VALUE)
 	, oblique_value_(OBLIQUE_VALUE)
+	, generation_(0)
+	, expanded_num_(0)
 {
-
+	nearby_nodes_.reserve(8);
 }
 
 AStar::~AStar()
 {
-	clear();
+
 }
 
 int AStar::step_value() const
@@ -39,38 +45,40 @@ void AStar::set_oblique_value(int value)
 	oblique_value_ = value;
 }
 
-void AStar::clear()
+size_t AStar::expanded_num() const
 {
-	size_t index = 0;
-	const size_t max_size = width_ * height_;
-	while (index < max_size)
-	{
-		delete maps_[index++];
-	}
-
-	width_ = 0;
-	height_ = 0;
-	query_ = nullptr;
-	open_list_.resize(0);
+	return expanded_num_;
 }
 
-void AStar::init(const Param &param)
+void AStar::init(uint16_t width, uint16_t height)
 {
-	width_ = param.width;
-	height_ = param.height;
-	query_ = param.is_canreach;
+	width_ = width;
+	height_ = height;
+	expanded_num_ = 0;
 
-	if (!maps_.empty())
+	const size_t max_size = width_ * height_;
+	if (nodes_.size() < max_size)
+	{
+		nodes_.resize(max_size);
+		open_list_.reserve(max_size);
+	}
+
+	// 编号回绕时重置所有节点，避免与很久以前的搜索混淆
+	if (++generation_ == 0)
 	{
-		memset(&maps_[0], 0, sizeof(Node *) * maps_.size());
+		for (auto &node : nodes_)
+		{
+			node.generation = 0;
+			node.target = 0;
+		}
+		generation_ = 1;
 	}
-	maps_.resize(width_ * height_, nullptr);
+	open_list_.clear();
 }
 
 bool AStar::vlid_param(const Param &param)
 {
-	return (param.is_canreach
-			&& (param.width > 0 && param.height > 0)
+	return ((param.width > 0 && param.height > 0)
 			&& (param.end.x >= 0 && param.end.x < param.width)
 			&& (param.end.y >= 0 && param.end.y < param.height)
 			&& (param.start.x >= 0 && param.start.x < param.width)
@@ -78,123 +86,97 @@ bool AStar::vlid_param(const Param &param)
 			);
 }
 
-bool AStar::get_node_index(Node *node, size_t &index)
+bool AStar::vlid_param(const MultiParam &param)
 {
-	index = 0;
-	const size_t size = open_list_.size();
-	while (index < size)
+	if (param.width == 0 || param.height == 0 || param.starts.empty() || param.ends.empty())
 	{
-		if (open_list_[index]->pos == node->pos)
-		{
-			return true;
-		}
-		++index;
+		return false;
 	}
-	return false;
-}
 
-void AStar::percolate_up(size_t hole)
-{
-	size_t parent = 0;
-	while (hole > 0)
+	for (const Vec2 &pos : param.starts)
 	{
-		parent = (hole - 1) / 2;
-		if (open_list_[hole]->f() < open_list_[parent]->f())
+		if (pos.x >= param.width || pos.y >= param.height)
 		{
-			std::swap(open_list_[hole], open_list_[parent]);
-			hole = parent;
+			return false;
 		}
-		else
+	}
+
+	for (const Vec2 &pos : param.ends)
+	{
+		if (pos.x >= param.width || pos.y >= param.height)
 		{
-			return;
+			return false;
 		}
 	}
+	return true;
 }
 
-inline uint16_t AStar::calcul_g_value(Node *parent_node, const Vec2 &current_pos)
+void AStar::build_path(const Node *node, bool with_start, std::vector<Vec2> &path)
 {
-	uint16_t g_value = ((abs(current_pos.y + current_pos.x - parent_node->pos.y - parent_node->pos.x)) == 2 ? oblique_value_ : step_value_);
-	return g_value += parent_node->g;
-}
-
-inline uint16_t AStar::calcul_h_value(const Vec2 &current_pos, const Vec2 &end_pos)
-{
-	unsigned int h_value = abs(end_pos.y + end_pos.x - current_pos.y - current_pos.x);
-	return h_value * step_value_;
-}
-
-inline bool AStar::has_node_in_open_list(const Vec2 &pos, Node *&out)
-{
-	out = maps_[pos.y * height_ + pos.x];
-	return out ? out->state == IN_OPENLIST : false;
-}
+	size_t length = with_start ? 1 : 0;
+	for (const Node *itr = node; itr->parent; itr = itr->parent)
+	{
+		++length;
+	}
 
-inline bool AStar::has_node_in_close_list(const Vec2 &pos)
-{
-	Node *node_ptr = maps_[pos.y * height_ + pos.x];
-	return node_ptr ? node_ptr->state == IN_CLOSELIST : false;
-}
+	path.resize(length);
+	while (node->parent)
+	{
+		path[--length] = node->pos;
+		node = node->parent;
+	}
 
-bool AStar::canreach(const Vec2 &pos)
-{
-	return (pos.x >= 0 && pos.x < width_ && pos.y >= 0 && pos.y < height_) ? query_(pos) : false;
+	if (with_start)
+	{
+		path[0] = node->pos;
+	}
 }
 
-bool AStar::canreach(const Vec2 &current_pos, const Vec2 &target_pos, bool allow_corner)
+// 跳点之间是横向、纵向或斜向的直线，逐格补全
+void AStar::build_jump_path(const Node *node, std::vector<Vec2> &path)
 {
-	if (target_pos.x >= 0 && target_pos.x < width_ && target_pos.y >= 0 && target_pos.y < height_)
+	size_t length = 0;
+	for (const Node *itr = node; itr->parent; itr = itr->parent)
 	{
-		if (has_node_in_close_list(target_pos))
-		{
-			return false;
-		}
+		length += std::max(abs(itr->pos.x - itr->parent->pos.x), abs(itr->pos.y - itr->parent->pos.y));
+	}
 
-		if (abs(current_pos.y + current_pos.x - target_pos.y - target_pos.x) == 1)
-		{
-			return query_(target_pos);
-		}
-		else if (allow_corner)
+	path.resize(length);
+	for (; node->parent; node = node->parent)
+	{
+		const int dx = (node->pos.x > node->parent->pos.x) - (node->pos.x < node->parent->pos.x);
+		const int dy = (node->pos.y > node->parent->pos.y) - (node->pos.y < node->parent->pos.y);
+		Vec2 pos = node->pos;
+		while (!(pos == node->parent->pos))
 		{
-			return (canreach(Vec2(current_pos.x + target_pos.x - current_pos.x, current_pos.y))
-					&& canreach(Vec2(current_pos.x, current_pos.y + target_pos.y - current_pos.y)));
+			path[--length] = pos;
+			pos.set(pos.x - dx, pos.y - dy);
 		}
 	}
-	return false;
 }
 
-void AStar::find_canreach_pos(const Vec2 &current_pos, bool allow_corner, std::vector<Vec2> &canreach_pos)
+// 八方向时为对角距离，四方向时为曼哈顿距离
+uint16_t AStar::calcul_distance(const Vec2 &a, const Vec2 &b, bool allow_corner) const
 {
-	Vec2 target_pos;
-	canreach_pos.clear();
-	int row_index = current_pos.y - 1;
-	const int max_row = current_pos.y + 1;
-	const int max_col = current_pos.x + 1;
-
-	if (row_index < 0)
+	const int dx = abs(a.x - b.x);
+	const int dy = abs(a.y - b.y);
+	if (!allow_corner)
 	{
-		row_index = 0;
+		return (dx + dy) * step_value_;
 	}
-	
-	while (row_index <= max_row)
-	{
-		int col_index = current_pos.x - 1;
+	return std::min(dx, dy) * oblique_value_ + abs(dx - dy) * step_value_;
+}
 
-		if (col_index < 0)
-		{
-			col_index = 0;
-		}
-	
-		while (col_index <= max_col)
-		{
-			target_pos.set(col_index, row_index);
-			if (canreach(current_pos, target_pos, allow_corner))
-			{
-				canreach_pos.push_back(target_pos);
-			}
-			++col_index;
-		}
-		++row_index;
-	}
+inline uint16_t AStar::calcul_g_value(Node *parent_node, const Vec2 &current_pos)
+{
+	uint16_t g_value = ((abs(current_pos.y + current_pos.x - parent_node->pos.y - parent_node->pos.x)) == 2 ? oblique_value_ : step_value_);
+	return g_value += parent_node->g;
+}
+
+inline uint16_t AStar::calcul_h_value(const Vec2 &current_pos, const Vec2 &end_pos)
+{
+	unsigned int h_value = abs(end_pos.y + end_pos.x - current_pos.y - current_pos.x);
+	return h_value * step_value_;
 }
 
 void AStar::handle_found_node(Node *current_node, Node *target_node)
@@ -205,11 +187,7 @@ void AStar::handle_found_node(Node *current_node, Node *target_node)
 		target_node->g = g_value;
 		target_node->parent = current_node;
 
-		size_t index = 0;
-		if (get_node_index(target_node, index))
-		{
-			percolate_up(index);
-		}
+		open_list_.decrease(target_node);
 	}
 }
 
@@ -219,84 +197,57 @@ void AStar::handle_not_found_node(Node *current_node, Node *target_node, const V
 	target_node->h = calcul_h_value(target_node->pos, end_pos);
 	target_node->g = calcul_g_value(current_node, target_node->pos);
 
-	Node *&node_ptr = maps_[target_node->pos.y * height_ + target_node->pos.x];
-	node_ptr = target_node;
-	node_ptr->state = IN_OPENLIST;
+	target_node->state = IN_OPENLIST;
 
-	open_list_.push_back(target_node);
-	std::push_heap(open_list_.begin(), open_list_.end(), [](const Node *a, const Node *b)->bool
+	open_list_.push(target_node);
+}
+
+void AStar::handle_open_node(Node *current_node, const Vec2 &pos, uint16_t g_value, uint16_t h_value)
+{
+	Node *node = nullptr;
+	if (has_node_in_open_list(pos, node))
+	{
+		if (g_value < node->g)
+		{
+			node->g = g_value;
+			node->parent = current_node;
+			open_list_.decrease(node);
+		}
+	}
+	else
 	{
-		return a->f() > b->f();
-	});
+		node = create_node(pos);
+		node->g = g_value;
+		node->h = h_value;
+		node->parent = current_node;
+		node->state = IN_OPENLIST;
+		open_list_.push(node);
+	}
 }
 
 std::deque<AStar::Vec2> AStar::search(const Param &param)
 {
-	if (!vlid_param(param))
+	if (!param.is_canreach)
 	{
 		throw std::runtime_error("invalid param!");
 	}
+	return search(param, param.is_canreach);
+}
 
-	init(param);
-	std::deque<Vec2> paths;
-	std::vector<Vec2> nearby_nodes;
-	nearby_nodes.reserve(param.allow_corner ? 8 : 4);
-
-	// 起点放入开启列表
-	Node *start_node = new Node(param.start);
-	open_list_.push_back(start_node);
-
-	// 设置起点所对应节点的状态
-	Node *&node_ptr = maps_[start_node->pos.y * height_ + start_node->pos.x];
-	node_ptr = start_node;
-	node_ptr->state = IN_OPENLIST;
-
-	while (!open_list_.empty())
+bool AStar::search(const Param &param, std::vector<Vec2> &path)
+{
+	if (!param.is_canreach)
 	{
-		// 取出F值最小的节点
-		Node *current_node = *open_list_.begin();
-		std::pop_heap(open_list_.begin(), open_list_.end(), [](const Node *a, const Node *b)->bool
-		{
-			return a->f() > b->f();
-		});
-		open_list_.pop_back();
-		maps_[current_node->pos.y * height_ + current_node->pos.x]->state = IN_CLOSELIST;
-
-		// 搜索附近可通行的位置
-		find_canreach_pos(current_node->pos, param.allow_corner, nearby_nodes);
-
-		size_t index = 0;
-		const size_t size = nearby_nodes.size();
-		while (index < size)
-		{
-			// 如果存在于开启列表
-			Node *new_node = nullptr;
-			if (has_node_in_open_list(nearby_nodes[index], new_node))
-			{
-				handle_found_node(current_node, new_node);
-			}
-			else
-			{
-				// 如果不存在于开启列表
-				new_node = new Node(nearby_nodes[index]);
-				handle_not_found_node(current_node, new_node, param.end);
-
-				// 找到终点
-				if (nearby_nodes[index] == param.end)
-				{
-					while (new_node->parent)
-					{
-						paths.push_front(new_node->pos);
-						new_node = new_node->parent;
-					}
-					goto __end__;
-				}
-			}
-			++index;
-		}
+		throw std::runtime_error("invalid param!");
 	}
+	return search(param, param.is_canreach, path);
+}
 
-__end__:
-	clear();
-	return paths;
+bool AStar::search(const MultiParam &param, std::vector<Vec2> &path)
+{
+	if (!param.is_canreach)
+	{
+		throw std::runtime_error("invalid param!");
+	}
+	return search(param, param.is_canreach, path);
 }
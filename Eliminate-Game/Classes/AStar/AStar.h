@@ -9,9 +9,13 @@
 
 #include <deque>
 #include <vector>
+#include <cstddef>
 #include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <algorithm>
 #include <functional>
-#include "BlockAllocator.h"
+#include "IndexedHeap.h"
 
 /**
  * A-Star algorithm
@@ -59,6 +63,7 @@ public:
 	struct Param
 	{
 		bool			allow_corner;
+		bool			jump_point;		// 使用跳点搜索，只在allow_corner时生效，要求所有可通行格子代价相同
 		uint16_t		height;
 		uint16_t		width;
 		Vec2			start;
@@ -70,6 +75,7 @@ public:
 			, width(0)
 			, is_canreach(nullptr)
 			, allow_corner(false)
+			, jump_point(false)
 		{
 		}
 
@@ -80,22 +86,35 @@ public:
 			, height(_height)
 			, is_canreach(_is_canreach)
 			, allow_corner(_allow_corner)
+			, jump_point(false)
 		{
 
 		}
 	};
 
-private:
 	/**
-	 * 节点对象分配器
+	 * 多起点多终点搜索参数
+	 * 从任意起点出发，找到距离最近的终点
 	 */
-	class SamllObjectAllocator : public BlockAllocator, public Singleton< SamllObjectAllocator >
+	struct MultiParam
 	{
-		SamllObjectAllocator() = default;
-		~SamllObjectAllocator() = default;
-		friend class Singleton< SamllObjectAllocator >;
+		bool				allow_corner;
+		uint16_t			height;
+		uint16_t			width;
+		std::vector<Vec2>	starts;
+		std::vector<Vec2>	ends;
+		QueryFunction		is_canreach;
+
+		MultiParam()
+			: allow_corner(false)
+			, height(0)
+			, width(0)
+			, is_canreach(nullptr)
+		{
+		}
 	};
 
+private:
 	/**
 	 * 路径节点状态
 	 */
@@ -108,6 +127,7 @@ private:
 
 	/**
 	 * 路径节点
+	 * 每个格子对应一个节点，在多次搜索间复用
 	 */
 	struct Node
 	{
@@ -116,29 +136,35 @@ private:
 		Vec2			pos;
 		NodeState		state;
 		Node*			parent;
+		size_t			heap_index;		// 在开启列表中的位置
+		uint32_t		generation;		// 与当前搜索编号不同时节点无效
+		uint32_t		target;			// 等于当前搜索编号时为终点
 
 		int f() const
 		{
 			return g + h;
 		}
 
-		inline Node(const Vec2 &pos)
+		inline Node()
 			: g(0)
 			, h(0)
-			, pos(pos)
 			, parent(nullptr)
 			, state(NOTEXIST)
+			, heap_index(0)
+			, generation(0)
+			, target(0)
 		{
 		}
+	};
 
-		void* operator new(std::size_t size)
-		{
-			return SamllObjectAllocator::instance()->allocate(size);
-		}
-
-		void operator delete(void* p) throw()
+	/**
+	 * 开启列表排序，F值相同时优先H值小的节点
+	 */
+	struct NodeCompare
+	{
+		bool operator() (const Node *a, const Node *b) const
 		{
-			SamllObjectAllocator::instance()->free(p, sizeof(Node));
+			return a->f() < b->f() || (a->f() == b->f() && a->h < b->h);
 		}
 	};
 
@@ -157,18 +183,55 @@ public:
 
 	std::deque<Vec2> search(const Param &param);
 
-private:
-	void clear();
+	/**
+	 * 路径写入调用者提供的缓冲区，不包含起点
+	 * 缓冲区容量足够时搜索过程不分配内存
+	 * @return 找到路径返回true
+	 */
+	bool search(const Param &param, std::vector<Vec2> &path);
 
-	void init(const Param &param);
+	/**
+	 * 使用函数对象判断是否可通行，调用可以被内联
+	 * 忽略 param.is_canreach
+	 * @param is_canreach bool(const Vec2&)
+	 */
+	template <typename Predicate>
+	std::deque<Vec2> search(const Param &param, const Predicate &is_canreach);
 
-	bool vlid_param(const Param &param);
+	template <typename Predicate>
+	bool search(const Param &param, const Predicate &is_canreach, std::vector<Vec2> &path);
+
+	/**
+	 * 多起点多终点搜索，一次搜索求出最近的终点
+	 * @param path 包含出发的起点，以找到的终点结尾
+	 * @return 找到路径返回true
+	 */
+	bool search(const MultiParam &param, std::vector<Vec2> &path);
+
+	template <typename Predicate>
+	bool search(const MultiParam &param, const Predicate &is_canreach, std::vector<Vec2> &path);
+
+	/**
+	 * 上次搜索展开的节点数量
+	 */
+	size_t expanded_num() const;
 
 private:
-	void percolate_up(size_t hole);
+	void init(uint16_t width, uint16_t height);
+
+	bool vlid_param(const Param &param);
+
+	bool vlid_param(const MultiParam &param);
+
+	Node* create_node(const Vec2 &pos);
+
+	void build_path(const Node *node, bool with_start, std::vector<Vec2> &path);
+
+	void build_jump_path(const Node *node, std::vector<Vec2> &path);
 
-	bool get_node_index(Node *node, size_t &index);
+	uint16_t calcul_distance(const Vec2 &a, const Vec2 &b, bool allow_corner) const;
 
+private:
 	uint16_t calcul_g_value(Node *parent_node, const Vec2 &current_pos);
 
 	uint16_t calcul_h_value(const Vec2 &current_pos, const Vec2 &end_pos);
@@ -177,24 +240,485 @@ private:
 
 	bool has_node_in_close_list(const Vec2 &pos);
 
-	bool canreach(const Vec2 &pos);
+	template <typename Predicate>
+	bool canreach(const Vec2 &pos, const Predicate &is_canreach);
 
-	bool canreach(const Vec2 &current_pos, const Vec2 &target_pos, bool allow_corner);
+	template <typename Predicate>
+	bool canreach(const Vec2 &current_pos, const Vec2 &target_pos, bool allow_corner, const Predicate &is_canreach);
 
-	void find_canreach_pos(const Vec2 &current_pos, bool allow_corner, std::vector<Vec2> &canreach_pos);
+	template <typename Predicate>
+	void find_canreach_pos(const Vec2 &current_pos, bool allow_corner, std::vector<Vec2> &canreach_pos, const Predicate &is_canreach);
 
 	void handle_found_node(Node *current_node, Node *target_node);
 
 	void handle_not_found_node(Node *current_node, Node *target_node, const Vec2 &end_pos);
 
+	void handle_open_node(Node *current_node, const Vec2 &pos, uint16_t g_value, uint16_t h_value);
+
+private:
+	template <typename Predicate>
+	bool walkable(int x, int y, const Predicate &is_canreach) const;
+
+	template <typename Predicate>
+	bool jump(int x, int y, int dx, int dy, const Vec2 &end_pos, const Predicate &is_canreach, Vec2 &out) const;
+
+	template <typename Predicate>
+	int find_jump_dirs(const Node *node, const Predicate &is_canreach, int (&dirs)[8][2]) const;
+
+	template <typename Predicate>
+	bool jump_search(const Param &param, const Predicate &is_canreach, std::vector<Vec2> &path);
+
 private:
 	int						step_value_;
 	int						oblique_value_;
-	std::vector<Node *>		maps_;
 	uint16_t				height_;
 	uint16_t				width_;
-	QueryFunction			query_;
-	std::vector<Node *>		open_list_;
+	uint32_t				generation_;	// 搜索编号，每次搜索加一使上次的节点全部失效
+	size_t					expanded_num_;
+	std::vector<Node>		nodes_;			// 按格子索引，只在棋盘变大时重新分配
+	std::vector<Vec2>		nearby_nodes_;
+	IndexedHeap<Node, NodeCompare>	open_list_;
 };
 
+inline AStar::Node* AStar::create_node(const Vec2 &pos)
+{
+	Node *node = &nodes_[pos.y * width_ + pos.x];
+	node->g = 0;
+	node->h = 0;
+	node->pos = pos;
+	node->state = NOTEXIST;
+	node->parent = nullptr;
+	node->generation = generation_;
+	return node;
+}
+
+inline bool AStar::has_node_in_open_list(const Vec2 &pos, Node *&out)
+{
+	out = &nodes_[pos.y * width_ + pos.x];
+	return out->generation == generation_ && out->state == IN_OPENLIST;
+}
+
+inline bool AStar::has_node_in_close_list(const Vec2 &pos)
+{
+	const Node &node = nodes_[pos.y * width_ + pos.x];
+	return node.generation == generation_ && node.state == IN_CLOSELIST;
+}
+
+template <typename Predicate>
+inline bool AStar::canreach(const Vec2 &pos, const Predicate &is_canreach)
+{
+	return (pos.x >= 0 && pos.x < width_ && pos.y >= 0 && pos.y < height_) ? is_canreach(pos) : false;
+}
+
+template <typename Predicate>
+inline bool AStar::canreach(const Vec2 &current_pos, const Vec2 &target_pos, bool allow_corner, const Predicate &is_canreach)
+{
+	if (target_pos.x >= 0 && target_pos.x < width_ && target_pos.y >= 0 && target_pos.y < height_)
+	{
+		if (has_node_in_close_list(target_pos))
+		{
+			return false;
+		}
+
+		if (abs(current_pos.y + current_pos.x - target_pos.y - target_pos.x) == 1)
+		{
+			return is_canreach(target_pos);
+		}
+		else if (allow_corner)
+		{
+			return (canreach(Vec2(current_pos.x + target_pos.x - current_pos.x, current_pos.y), is_canreach)
+					&& canreach(Vec2(current_pos.x, current_pos.y + target_pos.y - current_pos.y), is_canreach)
+					&& is_canreach(target_pos));
+		}
+	}
+	return false;
+}
+
+template <typename Predicate>
+void AStar::find_canreach_pos(const Vec2 &current_pos, bool allow_corner, std::vector<Vec2> &canreach_pos, const Predicate &is_canreach)
+{
+	Vec2 target_pos;
+	canreach_pos.clear();
+	int row_index = current_pos.y - 1;
+	const int max_row = current_pos.y + 1;
+	const int max_col = current_pos.x + 1;
+
+	if (row_index < 0)
+	{
+		row_index = 0;
+	}
+
+	while (row_index <= max_row)
+	{
+		int col_index = current_pos.x - 1;
+
+		if (col_index < 0)
+		{
+			col_index = 0;
+		}
+
+		while (col_index <= max_col)
+		{
+			target_pos.set(col_index, row_index);
+			if (canreach(current_pos, target_pos, allow_corner, is_canreach))
+			{
+				canreach_pos.push_back(target_pos);
+			}
+			++col_index;
+		}
+		++row_index;
+	}
+}
+
+template <typename Predicate>
+std::deque<AStar::Vec2> AStar::search(const Param &param, const Predicate &is_canreach)
+{
+	std::vector<Vec2> path;
+	search(param, is_canreach, path);
+	return std::deque<Vec2>(path.begin(), path.end());
+}
+
+template <typename Predicate>
+bool AStar::search(const Param &param, const Predicate &is_canreach, std::vector<Vec2> &path)
+{
+	if (!vlid_param(param))
+	{
+		throw std::runtime_error("invalid param!");
+	}
+
+	if (param.jump_point && param.allow_corner)
+	{
+		return jump_search(param, is_canreach, path);
+	}
+
+	init(param.width, param.height);
+	path.clear();
+	std::vector<Vec2> &nearby_nodes = nearby_nodes_;
+
+	// 起点放入开启列表
+	Node *start_node = create_node(param.start);
+	start_node->state = IN_OPENLIST;
+	open_list_.push(start_node);
+
+	while (!open_list_.empty())
+	{
+		// 取出F值最小的节点
+		Node *current_node = open_list_.pop();
+		current_node->state = IN_CLOSELIST;
+		++expanded_num_;
+
+		// 搜索附近可通行的位置
+		find_canreach_pos(current_node->pos, param.allow_corner, nearby_nodes, is_canreach);
+
+		size_t index = 0;
+		const size_t size = nearby_nodes.size();
+		while (index < size)
+		{
+			// 如果存在于开启列表
+			Node *new_node = nullptr;
+			if (has_node_in_open_list(nearby_nodes[index], new_node))
+			{
+				handle_found_node(current_node, new_node);
+			}
+			else
+			{
+				// 如果不存在于开启列表
+				new_node = create_node(nearby_nodes[index]);
+				handle_not_found_node(current_node, new_node, param.end);
+
+				// 找到终点
+				if (nearby_nodes[index] == param.end)
+				{
+					build_path(new_node, false, path);
+					return true;
+				}
+			}
+			++index;
+		}
+	}
+
+	return false;
+}
+
+template <typename Predicate>
+bool AStar::search(const MultiParam &param, const Predicate &is_canreach, std::vector<Vec2> &path)
+{
+	// 终点较多时逐个计算估值的开销超过收益，退化为Dijkstra
+	static const size_t kMaxEstimateTargets = 8;
+
+	if (!vlid_param(param))
+	{
+		throw std::runtime_error("invalid param!");
+	}
+
+	init(param.width, param.height);
+	path.clear();
+	std::vector<Vec2> &nearby_nodes = nearby_nodes_;
+
+	// 标记终点
+	for (const Vec2 &pos : param.ends)
+	{
+		nodes_[pos.y * width_ + pos.x].target = generation_;
+	}
+
+	auto estimate = [&](const Vec2 &pos)->uint16_t
+	{
+		if (param.ends.size() > kMaxEstimateTargets)
+		{
+			return 0;
+		}
+
+		uint16_t h_value = UINT16_MAX;
+		for (const Vec2 &end_pos : param.ends)
+		{
+			h_value = std::min(h_value, calcul_distance(pos, end_pos, param.allow_corner));
+		}
+		return h_value;
+	};
+
+	// 所有起点放入开启列表
+	for (const Vec2 &pos : param.starts)
+	{
+		Node *start_node = nullptr;
+		if (!has_node_in_open_list(pos, start_node))
+		{
+			start_node = create_node(pos);
+			start_node->h = estimate(pos);
+			start_node->state = IN_OPENLIST;
+			open_list_.push(start_node);
+		}
+	}
+
+	while (!open_list_.empty())
+	{
+		// 取出F值最小的节点，取出时才判断终点，保证是最近的终点
+		Node *current_node = open_list_.pop();
+		current_node->state = IN_CLOSELIST;
+		++expanded_num_;
+		if (current_node->target == generation_)
+		{
+			build_path(current_node, true, path);
+			return true;
+		}
+
+		// 搜索附近可通行的位置
+		find_canreach_pos(current_node->pos, param.allow_corner, nearby_nodes, is_canreach);
+		for (const Vec2 &pos : nearby_nodes)
+		{
+			Node *new_node = nullptr;
+			const uint16_t h_value = has_node_in_open_list(pos, new_node) ? new_node->h : estimate(pos);
+			handle_open_node(current_node, pos, current_node->g + calcul_distance(current_node->pos, pos, param.allow_corner), h_value);
+		}
+	}
+
+	return false;
+}
+
+template <typename Predicate>
+inline bool AStar::walkable(int x, int y, const Predicate &is_canreach) const
+{
+	return x >= 0 && x < width_ && y >= 0 && y < height_ && is_canreach(Vec2(x, y));
+}
+
+// 沿(dx, dy)方向前进直到遇到跳点或无法通行
+// 只有两侧都可通行时才能斜向移动，因此只有直线移动会产生强迫邻居
+template <typename Predicate>
+bool AStar::jump(int x, int y, int dx, int dy, const Vec2 &end_pos, const Predicate &is_canreach, Vec2 &out) const
+{
+	while (walkable(x, y, is_canreach))
+	{
+		if (x == end_pos.x && y == end_pos.y)
+		{
+			out.set(x, y);
+			return true;
+		}
+
+		if (dx != 0 && dy != 0)
+		{
+			// 斜向移动时，横向或纵向可以到达跳点则当前位置是跳点
+			Vec2 next;
+			if (jump(x + dx, y, dx, 0, end_pos, is_canreach, next) || jump(x, y + dy, 0, dy, end_pos, is_canreach, next))
+			{
+				out.set(x, y);
+				return true;
+			}
+		}
+		else if (dx != 0)
+		{
+			if ((walkable(x, y - 1, is_canreach) && !walkable(x - dx, y - 1, is_canreach))
+				|| (walkable(x, y + 1, is_canreach) && !walkable(x - dx, y + 1, is_canreach)))
+			{
+				out.set(x, y);
+				return true;
+			}
+		}
+		else
+		{
+			if ((walkable(x - 1, y, is_canreach) && !walkable(x - 1, y - dy, is_canreach))
+				|| (walkable(x + 1, y, is_canreach) && !walkable(x + 1, y - dy, is_canreach)))
+			{
+				out.set(x, y);
+				return true;
+			}
+		}
+
+		if (!walkable(x + dx, y, is_canreach) || !walkable(x, y + dy, is_canreach))
+		{
+			return false;
+		}
+		x += dx;
+		y += dy;
+	}
+	return false;
+}
+
+// 按到达方向裁剪需要继续搜索的方向
+template <typename Predicate>
+int AStar::find_jump_dirs(const Node *node, const Predicate &is_canreach, int (&dirs)[8][2]) const
+{
+	int num = 0;
+	auto add = [&](int dx, int dy)
+	{
+		dirs[num][0] = dx;
+		dirs[num][1] = dy;
+		++num;
+	};
+
+	const int x = node->pos.x;
+	const int y = node->pos.y;
+	if (node->parent == nullptr)
+	{
+		for (int dy = -1; dy <= 1; ++dy)
+		{
+			for (int dx = -1; dx <= 1; ++dx)
+			{
+				if ((dx != 0 || dy != 0)
+					&& (dx == 0 || dy == 0 || (walkable(x + dx, y, is_canreach) && walkable(x, y + dy, is_canreach))))
+				{
+					add(dx, dy);
+				}
+			}
+		}
+		return num;
+	}
+
+	const int dx = (x > node->parent->pos.x) - (x < node->parent->pos.x);
+	const int dy = (y > node->parent->pos.y) - (y < node->parent->pos.y);
+	if (dx != 0 && dy != 0)
+	{
+		const bool vertical = walkable(x, y + dy, is_canreach);
+		const bool horizontal = walkable(x + dx, y, is_canreach);
+		if (vertical)
+		{
+			add(0, dy);
+		}
+		if (horizontal)
+		{
+			add(dx, 0);
+		}
+		if (vertical && horizontal)
+		{
+			add(dx, dy);
+		}
+	}
+	else if (dx != 0)
+	{
+		const bool up = walkable(x, y + 1, is_canreach);
+		const bool down = walkable(x, y - 1, is_canreach);
+		if (walkable(x + dx, y, is_canreach))
+		{
+			add(dx, 0);
+			if (up)
+			{
+				add(dx, 1);
+			}
+			if (down)
+			{
+				add(dx, -1);
+			}
+		}
+		if (up)
+		{
+			add(0, 1);
+		}
+		if (down)
+		{
+			add(0, -1);
+		}
+	}
+	else
+	{
+		const bool right = walkable(x + 1, y, is_canreach);
+		const bool left = walkable(x - 1, y, is_canreach);
+		if (walkable(x, y + dy, is_canreach))
+		{
+			add(0, dy);
+			if (right)
+			{
+				add(1, dy);
+			}
+			if (left)
+			{
+				add(-1, dy);
+			}
+		}
+		if (right)
+		{
+			add(1, 0);
+		}
+		if (left)
+		{
+			add(-1, 0);
+		}
+	}
+	return num;
+}
+
+// 跳点搜索
+// 开启列表中只保存跳点，取出终点时得到最短路径
+template <typename Predicate>
+bool AStar::jump_search(const Param &param, const Predicate &is_canreach, std::vector<Vec2> &path)
+{
+	init(param.width, param.height);
+	path.clear();
+	if (param.start == param.end)
+	{
+		return false;
+	}
+
+	Node *start_node = create_node(param.start);
+	start_node->h = calcul_distance(param.start, param.end, true);
+	start_node->state = IN_OPENLIST;
+	open_list_.push(start_node);
+
+	int dirs[8][2];
+	while (!open_list_.empty())
+	{
+		Node *current_node = open_list_.pop();
+		current_node->state = IN_CLOSELIST;
+		++expanded_num_;
+		if (current_node->pos == param.end)
+		{
+			build_jump_path(current_node, path);
+			return true;
+		}
+
+		const int num = find_jump_dirs(current_node, is_canreach, dirs);
+		for (int i = 0; i < num; ++i)
+		{
+			Vec2 pos;
+			const int dx = dirs[i][0];
+			const int dy = dirs[i][1];
+			if (jump(current_node->pos.x + dx, current_node->pos.y + dy, dx, dy, param.end, is_canreach, pos)
+				&& !has_node_in_close_list(pos))
+			{
+				const uint16_t g_value = current_node->g + calcul_distance(current_node->pos, pos, true);
+				handle_open_node(current_node, pos, g_value, calcul_distance(pos, param.end, true));
+			}
+		}
+	}
+
+	return false;
+}
+
 #endif
\ No newline at end of file
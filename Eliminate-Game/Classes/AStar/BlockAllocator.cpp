@@ -3,6 +3,7 @@
 #include <stddef.h>
 #include <malloc.h>
 #include <assert.h>
+#include <stdlib.h>
 #include "BlockAllocator.h"
 
 
@@ -17,6 +18,40 @@ struct Block
 	Block *next;
 };
 
+// 块区按大小对齐，首个块的位置保存块区信息，由块的地址即可找到所属的分配器
+struct ChunkHeader
+{
+	BlockAllocator *owner;
+	int block_size;
+};
+
+namespace
+{
+	void* allocate_chunk()
+	{
+#if defined(_MSC_VER)
+		return _aligned_malloc(g_chunk_size, g_chunk_size);
+#else
+		void *p = nullptr;
+		return posix_memalign(&p, g_chunk_size, g_chunk_size) == 0 ? p : nullptr;
+#endif
+	}
+
+	void free_chunk(void *p)
+	{
+#if defined(_MSC_VER)
+		_aligned_free(p);
+#else
+		::free(p);
+#endif
+	}
+
+	inline ChunkHeader* chunk_header(const void *p)
+	{
+		return (ChunkHeader *)((uintptr_t)p & ~(uintptr_t)(g_chunk_size - 1));
+	}
+}
+
 int BlockAllocator::block_sizes_[g_block_sizes] =
 {
 	16,		// 0
@@ -35,8 +70,6 @@ int BlockAllocator::block_sizes_[g_block_sizes] =
 	640,	// 13
 };
 
-bool BlockAllocator::s_block_size_lookup_initialized_;
-
 uint8_t BlockAllocator::s_block_size_lookup_[g_max_block_size + 1];
 
 BlockAllocator::BlockAllocator()
@@ -49,32 +82,43 @@ BlockAllocator::BlockAllocator()
 
 	memset(chunks_, 0, num_chunk_space_ * sizeof(Chunk));
 	memset(free_lists_, 0, sizeof(free_lists_));
+	remote_free_list_.store(nullptr, std::memory_order_relaxed);
+
+	// 局部静态变量的初始化是线程安全的，多个线程同时创建分配器时只初始化一次
+	static const bool s_block_size_lookup_initialized = init_block_size_lookup();
+	(void)s_block_size_lookup_initialized;
 
-	if (s_block_size_lookup_initialized_ == false)
+	memset(stats_, 0, sizeof(stats_));
+	for (int i = 0; i < g_block_sizes; ++i)
 	{
-		int j = 0;
-		for (int i = 1; i <= g_max_block_size; ++i)
+		stats_[i].block_size = block_sizes_[i];
+	}
+}
+
+bool BlockAllocator::init_block_size_lookup()
+{
+	int j = 0;
+	for (int i = 1; i <= g_max_block_size; ++i)
+	{
+		assert(j < g_block_sizes);
+		if (i <= block_sizes_[j])
+		{
+			s_block_size_lookup_[i] = (uint8_t)j;
+		}
+		else
 		{
-			assert(j < g_block_sizes);
-			if (i <= block_sizes_[j])
-			{
-				s_block_size_lookup_[i] = (uint8_t)j;
-			}
-			else
-			{
-				++j;
-				s_block_size_lookup_[i] = (uint8_t)j;
-			}
+			++j;
+			s_block_size_lookup_[i] = (uint8_t)j;
 		}
-		s_block_size_lookup_initialized_ = true;
 	}
+	return true;
 }
 
 BlockAllocator::~BlockAllocator()
 {
 	for (int i = 0; i < num_chunk_count_; ++i)
 	{
-		::free(chunks_[i].blocks);
+		free_chunk(chunks_[i].blocks);
 	}
 	::free(chunks_);
 }
@@ -96,7 +140,13 @@ void* BlockAllocator::allocate(int size)
 	int index = s_block_size_lookup_[size];
 	assert(0 <= index && index < g_block_sizes);
 
-	if (free_lists_[index])
+	Stats &stats = stats_[index];
+	if (++stats.live_blocks > stats.peak_blocks)
+	{
+		stats.peak_blocks = stats.live_blocks;
+	}
+
+	if (free_lists_[index] || (collect_remote() && free_lists_[index]))
 	{
 		Block *block = free_lists_[index];
 		free_lists_[index] = block->next;
@@ -115,15 +165,27 @@ void* BlockAllocator::allocate(int size)
 		}
 
 		Chunk *chunk = chunks_ + num_chunk_count_;
-		chunk->blocks = (Block *)malloc(g_chunk_size);
+		chunk->blocks = (Block *)allocate_chunk();
+		if (chunk->blocks == nullptr)
+		{
+			--stats.live_blocks;
+			return nullptr;
+		}
 #if defined(_DEBUG)
 		memset(chunk->blocks, 0xcd, g_chunk_size);
 #endif
 		int block_size = block_sizes_[index];
 		chunk->block_size = block_size;
+
+		// 首个块用于保存块区信息
+		assert(sizeof(ChunkHeader) <= (size_t)block_size);
+		ChunkHeader *header = (ChunkHeader *)chunk->blocks;
+		header->owner = this;
+		header->block_size = block_size;
+
 		int block_count = g_chunk_size / block_size;
 		assert(block_count * block_size <= g_chunk_size);
-		for (int i = 0; i < block_count - 1; ++i)
+		for (int i = 1; i < block_count - 1; ++i)
 		{
 			Block *block = (Block *)((uint8_t *)chunk->blocks + block_size * i);
 			Block *next = (Block *)((uint8_t *)chunk->blocks + block_size * (i + 1));
@@ -132,10 +194,12 @@ void* BlockAllocator::allocate(int size)
 		Block *last = (Block *)((uint8_t *)chunk->blocks + block_size * (block_count - 1));
 		last->next = nullptr;
 
-		free_lists_[index] = chunk->blocks->next;
+		Block *first = (Block *)((uint8_t *)chunk->blocks + block_size);
+		free_lists_[index] = first->next;
 		++num_chunk_count_;
+		++stats.chunk_num;
 
-		return chunk->blocks;
+		return first;
 	}
 }
 
@@ -157,44 +221,89 @@ void BlockAllocator::free(void *p, int size)
 	int index = s_block_size_lookup_[size];
 	assert(0 <= index && index < g_block_sizes);
 
-#ifdef _DEBUG
-	int block_size = block_sizes_[index];
-	bool found = false;
-	for (int i = 0; i < num_chunk_count_; ++i)
-	{
-		Chunk *chunk = chunks_ + i;
-		if (chunk->block_size != block_size)
-		{
-			assert((uint8_t *)p + block_size <= (uint8_t *)chunk->blocks ||
-				(uint8_t *)chunk->blocks + g_chunk_size <= (uint8_t *)p);
-		}
-		else
-		{
-			if ((uint8_t *)chunk->blocks <= (uint8_t *)p && (uint8_t *)p + block_size <= (uint8_t *)chunk->blocks + g_chunk_size)
-			{
-				found = true;
-			}
-		}
-	}
-
-	assert(found);
+	ChunkHeader *header = chunk_header(p);
+	assert(header->block_size == block_sizes_[index]);
+	assert(((uint8_t *)p - (uint8_t *)header) % header->block_size == 0 && (uint8_t *)p != (uint8_t *)header);
 
-	memset(p, 0xfd, block_size);
+#ifdef _DEBUG
+	memset(p, 0xfd, block_sizes_[index]);
 #endif
 
 	Block *block = (Block *)p;
+	if (header->owner != this)
+	{
+		header->owner->free_remote(block);
+		return;
+	}
+
 	block->next = free_lists_[index];
 	free_lists_[index] = block;
+	--stats_[index].live_blocks;
+}
+
+// 其他线程释放的块
+// 多个线程可能同时释放，只在链表头部插入
+void BlockAllocator::free_remote(Block *block)
+{
+	Block *head = remote_free_list_.load(std::memory_order_relaxed);
+	do
+	{
+		block->next = head;
+	} while (!remote_free_list_.compare_exchange_weak(head, block, std::memory_order_release, std::memory_order_relaxed));
 }
 
+// 回收其他线程释放的块
+// 一次取走整个链表，按块区记录的大小放回各自的空闲链表
+bool BlockAllocator::collect_remote()
+{
+	Block *block = remote_free_list_.exchange(nullptr, std::memory_order_acquire);
+	if (block == nullptr)
+	{
+		return false;
+	}
+
+	while (block != nullptr)
+	{
+		Block *next = block->next;
+		int index = s_block_size_lookup_[chunk_header(block)->block_size];
+		block->next = free_lists_[index];
+		free_lists_[index] = block;
+		--stats_[index].live_blocks;
+		block = next;
+	}
+	return true;
+}
+
+// 获取统计
+void BlockAllocator::get_stats(Stats (&ret)[g_block_sizes]) const
+{
+	memcpy(ret, stats_, sizeof(stats_));
+}
+
+// 释放所有块区
+// 先回收其他线程释放的块，之后不应再有未释放的块
 void BlockAllocator::clear()
 {
+	collect_remote();
+#if !defined(NDEBUG)
+	for (int i = 0; i < g_block_sizes; ++i)
+	{
+		assert(stats_[i].live_blocks == 0);
+	}
+#endif
+
 	for (int i = 0; i < num_chunk_count_; ++i)
 	{
-		::free(chunks_[i].blocks);
+		free_chunk(chunks_[i].blocks);
 	}
 
 	num_chunk_count_ = 0;
 	memset(chunks_, 0, num_chunk_space_ * sizeof(Chunk));
 	memset(free_lists_, 0, sizeof(free_lists_));
+	remote_free_list_.store(nullptr, std::memory_order_relaxed);
+	for (int i = 0; i < g_block_sizes; ++i)
+	{
+		stats_[i].live_blocks = 0;
+		stats_[i].chunk_num = 0;
+	}
 }
\ No newline at end of file
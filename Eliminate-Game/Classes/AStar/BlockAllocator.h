@@ -1,12 +1,15 @@
-﻿/**
+/**
  * 小对象管理器
+ * 每个分配器只能由一个线程使用，块可以在任意线程释放，
+ * 不属于当前分配器的块会交还给所属的分配器
  */
 
 #ifndef __BLOCKALLOCATOR_H__
 #define __BLOCKALLOCATOR_H__
 
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
-#include "singleton.h"
 
 static const int g_chunk_size = 16 * 1024;
 static const int g_max_block_size = 640;
@@ -18,6 +21,18 @@ static const int g_chunk_array_increment = 128;
 /// See: http://www.codeproject.com/useritems/Small_Block_Allocator.asp
 class BlockAllocator
 {
+public:
+	/**
+	 * 单个块大小的统计
+	 */
+	struct Stats
+	{
+		int			block_size;
+		size_t		live_blocks;		// 尚未释放的块，其他线程释放的块在下次补充空闲链表时才扣除
+		size_t		peak_blocks;		// 同时存在的块的最大数量
+		size_t		chunk_num;
+	};
+
 public:
 	BlockAllocator();
 	~BlockAllocator();
@@ -25,16 +40,40 @@ public:
 public:
 	void* allocate(int size);
 	void free(void *p, int size);
+
+	/**
+	 * 释放所有块区
+	 * 所有块都必须已经释放，包括在其他线程释放的块
+	 */
 	void clear();
 
+	/**
+	 * 获取统计
+	 */
+	void get_stats(Stats (&ret)[g_block_sizes]) const;
+
+private:
+	static bool init_block_size_lookup();
+
+	/**
+	 * 其他线程释放的块
+	 */
+	void free_remote(struct Block *block);
+
+	/**
+	 * 回收其他线程释放的块
+	 */
+	bool collect_remote();
+
 private:
-	int				num_chunk_count_;
-	int				num_chunk_space_;
-	struct Chunk*	chunks_;
-	struct Block*	free_lists_[g_block_sizes];
-	static int		block_sizes_[g_block_sizes];
-	static uint8_t	s_block_size_lookup_[g_max_block_size + 1];
-	static bool		s_block_size_lookup_initialized_;
+	int						num_chunk_count_;
+	int						num_chunk_space_;
+	struct Chunk*			chunks_;
+	struct Block*			free_lists_[g_block_sizes];
+	std::atomic<Block*>		remote_free_list_;			// 其他线程释放的块，不区分大小
+	Stats					stats_[g_block_sizes];
+	static int				block_sizes_[g_block_sizes];
+	static uint8_t			s_block_size_lookup_[g_max_block_size + 1];
 };
 
-#endif
\ No newline at end of file
+#endif
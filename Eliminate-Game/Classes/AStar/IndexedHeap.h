@@ -0,0 +1,155 @@
+﻿/**
+ * 索引d叉堆
+ * 元素记录自己在堆中的位置，减小键值时不需要查找，复杂度为O(log n)
+ */
+
+#ifndef __INDEXEDHEAP_H__
+#define __INDEXEDHEAP_H__
+
+#include <vector>
+#include <cstddef>
+#include <cassert>
+
+/**
+ * @param T 元素类型，需要有可写的 size_t heap_index 成员
+ * @param Compare compare(a, b)为true时a更靠近堆顶
+ * @param Arity 分支数量，4叉堆层数更少，同一节点的子节点在内存中相邻
+ */
+template <typename T, typename Compare, size_t Arity = 4>
+class IndexedHeap
+{
+public:
+	explicit IndexedHeap(const Compare &compare = Compare())
+		: compare_(compare)
+	{
+	}
+
+	bool empty() const
+	{
+		return items_.empty();
+	}
+
+	size_t size() const
+	{
+		return items_.size();
+	}
+
+	void reserve(size_t size)
+	{
+		items_.reserve(size);
+	}
+
+	/**
+	 * 清空，保留已分配的容量
+	 */
+	void clear()
+	{
+		items_.clear();
+	}
+
+	/**
+	 * 堆顶元素
+	 */
+	T* top() const
+	{
+		assert(!items_.empty());
+		return items_.front();
+	}
+
+	/**
+	 * 插入元素
+	 */
+	void push(T *item)
+	{
+		item->heap_index = items_.size();
+		items_.push_back(item);
+		sift_up(item->heap_index);
+	}
+
+	/**
+	 * 取出堆顶元素
+	 */
+	T* pop()
+	{
+		assert(!items_.empty());
+		T *ret = items_.front();
+		T *last = items_.back();
+		items_.pop_back();
+		if (!items_.empty())
+		{
+			items_[0] = last;
+			last->heap_index = 0;
+			sift_down(0);
+		}
+		return ret;
+	}
+
+	/**
+	 * 元素键值变小后调整位置
+	 */
+	void decrease(T *item)
+	{
+		assert(item->heap_index < items_.size() && items_[item->heap_index] == item);
+		sift_up(item->heap_index);
+	}
+
+private:
+	void sift_up(size_t hole)
+	{
+		T *item = items_[hole];
+		while (hole > 0)
+		{
+			const size_t parent = (hole - 1) / Arity;
+			if (!compare_(item, items_[parent]))
+			{
+				break;
+			}
+			items_[hole] = items_[parent];
+			items_[hole]->heap_index = hole;
+			hole = parent;
+		}
+		items_[hole] = item;
+		item->heap_index = hole;
+	}
+
+	void sift_down(size_t hole)
+	{
+		T *item = items_[hole];
+		const size_t size = items_.size();
+		while (true)
+		{
+			const size_t first = hole * Arity + 1;
+			if (first >= size)
+			{
+				break;
+			}
+
+			// 找出最靠近堆顶的子节点
+			size_t best = first;
+			const size_t last = first + Arity < size ? first + Arity : size;
+			for (size_t child = first + 1; child < last; ++child)
+			{
+				if (compare_(items_[child], items_[best]))
+				{
+					best = child;
+				}
+			}
+
+			if (!compare_(items_[best], item))
+			{
+				break;
+			}
+			items_[hole] = items_[best];
+			items_[hole]->heap_index = hole;
+			hole = best;
+		}
+		items_[hole] = item;
+		item->heap_index = hole;
+	}
+
+private:
+	std::vector<T *>		items_;
+	Compare					compare_;
+};
+
+#endif
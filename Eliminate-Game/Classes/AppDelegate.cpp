@@ -47,6 +47,9 @@ bool AppDelegate::applicationDidFinishLaunching() {
     // turn on display FPS
     director->setDisplayStats(false);
 
+    // 同一层级的精灵按材质合并绘制
+    director->getRenderer()->setQuadReorderEnabled(true);
+
     // set FPS. the default value is 1.0/60 if you don't call this
     director->setAnimationInterval(1.0 / 60);
 
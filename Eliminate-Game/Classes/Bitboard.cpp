@@ -0,0 +1,289 @@
+﻿#include "Bitboard.h"
+
+#include <cassert>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define BITBOARD_USE_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BITBOARD_USE_SSE2
+#endif
+
+
+Bitboard::Bitboard()
+	: width_(0)
+	, height_(0)
+	, type_num_(0)
+	, row_stride_(0)
+{
+
+}
+
+// 重置
+void Bitboard::reset(int width, int height, int type_num)
+{
+	assert(width > 0 && width <= kMaxSize);
+	assert(height > 0 && height <= kMaxSize);
+	assert(type_num > 0);
+
+	width_ = width;
+	height_ = height;
+	type_num_ = type_num;
+	row_stride_ = height + 4;
+	rows_.assign((type_num + 1) * row_stride_, 0);
+	cols_.assign((type_num + 1) * width, 0);
+}
+
+// 查找经过指定位置的连续元素
+bool Bitboard::find_match_at(int x, int y, int type, Line *ret) const
+{
+	assert(type > 0 && type <= type_num_);
+	bool found = false;
+
+	// 横向
+	{
+		const Line line = row(type, y);
+		if (line & (Line(1) << x))
+		{
+			const int forward = trailing_ones(line >> x);
+			const int backward = leading_ones(line << (63 - x));
+			const int length = forward + backward - 1;
+			if (length >= kMatchLength)
+			{
+				ret[y] |= range_mask(x - backward + 1, length);
+				found = true;
+			}
+		}
+	}
+
+	// 纵向
+	{
+		const Line line = col(type, x);
+		if (line & (Line(1) << y))
+		{
+			const int forward = trailing_ones(line >> y);
+			const int backward = leading_ones(line << (63 - y));
+			const int length = forward + backward - 1;
+			if (length >= kMatchLength)
+			{
+				const Line bit = Line(1) << x;
+				for (int row = y - backward + 1; row < y + forward; ++row)
+				{
+					ret[row] |= bit;
+				}
+				found = true;
+			}
+		}
+	}
+
+	return found;
+}
+
+// 在指定位置放置该类型后是否形成三消
+bool Bitboard::would_match(int x, int y, int type) const
+{
+	assert(type > 0 && type <= type_num_);
+
+	const Line row_line = row(type, y) | (Line(1) << x);
+	if (trailing_ones(row_line >> x) + leading_ones(row_line << (63 - x)) - 1 >= kMatchLength)
+	{
+		return true;
+	}
+
+	const Line col_line = col(type, x) | (Line(1) << y);
+	return trailing_ones(col_line >> y) + leading_ones(col_line << (63 - y)) - 1 >= kMatchLength;
+}
+
+// 查找整个棋盘中可消除的元素
+// 横向: 行内三个相邻位同时为1；纵向: 相邻三行同一位同时为1
+// 行位图前后各填充两行空行，纵向检测无需边界判断，可按行批量计算
+bool Bitboard::find_all_matches(Line *ret) const
+{
+	memset(ret, 0, sizeof(Line) * height_);
+
+	for (int type = 1; type <= type_num_; ++type)
+	{
+		const Line *rows = &rows_[type * row_stride_ + 2];
+		int y = 0;
+
+#if defined(BITBOARD_USE_AVX2)
+		for (; y + 4 <= height_; y += 4)
+		{
+			const __m256i r0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rows + y - 2));
+			const __m256i r1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rows + y - 1));
+			const __m256i r2 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rows + y));
+			const __m256i r3 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rows + y + 1));
+			const __m256i r4 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rows + y + 2));
+
+			__m256i h = _mm256_and_si256(r2, _mm256_and_si256(_mm256_srli_epi64(r2, 1), _mm256_srli_epi64(r2, 2)));
+			h = _mm256_or_si256(h, _mm256_or_si256(_mm256_slli_epi64(h, 1), _mm256_slli_epi64(h, 2)));
+
+			const __m256i r12 = _mm256_and_si256(r1, r2);
+			const __m256i r23 = _mm256_and_si256(r2, r3);
+			__m256i v = _mm256_and_si256(r0, r12);
+			v = _mm256_or_si256(v, _mm256_and_si256(r12, r3));
+			v = _mm256_or_si256(v, _mm256_and_si256(r23, r4));
+
+			__m256i *out = reinterpret_cast<__m256i *>(ret + y);
+			_mm256_storeu_si256(out, _mm256_or_si256(_mm256_loadu_si256(out), _mm256_or_si256(h, v)));
+		}
+#elif defined(BITBOARD_USE_SSE2)
+		for (; y + 2 <= height_; y += 2)
+		{
+			const __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows + y - 2));
+			const __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows + y - 1));
+			const __m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows + y));
+			const __m128i r3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows + y + 1));
+			const __m128i r4 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows + y + 2));
+
+			__m128i h = _mm_and_si128(r2, _mm_and_si128(_mm_srli_epi64(r2, 1), _mm_srli_epi64(r2, 2)));
+			h = _mm_or_si128(h, _mm_or_si128(_mm_slli_epi64(h, 1), _mm_slli_epi64(h, 2)));
+
+			const __m128i r12 = _mm_and_si128(r1, r2);
+			const __m128i r23 = _mm_and_si128(r2, r3);
+			__m128i v = _mm_and_si128(r0, r12);
+			v = _mm_or_si128(v, _mm_and_si128(r12, r3));
+			v = _mm_or_si128(v, _mm_and_si128(r23, r4));
+
+			__m128i *out = reinterpret_cast<__m128i *>(ret + y);
+			_mm_storeu_si128(out, _mm_or_si128(_mm_loadu_si128(out), _mm_or_si128(h, v)));
+		}
+#endif
+
+		for (; y < height_; ++y)
+		{
+			const Line r2 = rows[y];
+			Line h = r2 & (r2 >> 1) & (r2 >> 2);
+			h |= (h << 1) | (h << 2);
+
+			const Line r12 = rows[y - 1] & r2;
+			const Line r23 = r2 & rows[y + 1];
+			const Line v = (rows[y - 2] & r12) | (r12 & rows[y + 1]) | (r23 & rows[y + 2]);
+
+			ret[y] |= h | v;
+		}
+	}
+
+	Line any = 0;
+	for (int y = 0; y < height_; ++y)
+	{
+		any |= ret[y];
+	}
+	return any != 0;
+}
+
+// 查找指定格子中可消除的元素
+bool Bitboard::find_matches_in(const Line *cells, Line *ret) const
+{
+	Line any = 0;
+	for (int y = 0; y < height_; ++y)
+	{
+		ret[y] = 0;
+		if (cells[y] == 0)
+		{
+			continue;
+		}
+
+		for (int type = 1; type <= type_num_; ++type)
+		{
+			const Line *rows = &rows_[type * row_stride_ + 2];
+			const Line r2 = rows[y] & cells[y];
+			if (r2 == 0)
+			{
+				continue;
+			}
+
+			Line h = rows[y] & (rows[y] >> 1) & (rows[y] >> 2);
+			h |= (h << 1) | (h << 2);
+
+			const Line r12 = rows[y - 1] & r2;
+			const Line r23 = r2 & rows[y + 1];
+			const Line v = (rows[y - 2] & r12) | (r12 & rows[y + 1]) | (r23 & rows[y + 2]);
+
+			ret[y] |= (h & r2) | v;
+		}
+		any |= ret[y];
+	}
+	return any != 0;
+}
+
+// 查找所有可以形成消除的交换
+bool Bitboard::find_moves(Line *horizontal, Line *vertical) const
+{
+	return scan_moves(horizontal, vertical, false);
+}
+
+// 是否存在可以形成消除的交换
+bool Bitboard::has_move() const
+{
+	Line horizontal[kMaxSize];
+	Line vertical[kMaxSize];
+	return scan_moves(horizontal, vertical, true);
+}
+
+// 扫描可以形成消除的交换
+// 类型t从相邻位置Q移入位置P时，P处需要满足的三消模式只能使用除Q以外的t，因此按移入方向分别计算:
+//   从右侧移入: 左侧两格，或纵向任意模式
+//   从左侧移入: 右侧两格，或纵向任意模式
+//   从上方移入: 横向任意模式，或下方两格
+//   从下方移入: 横向任意模式，或上方两格
+// 每种模式都是相邻行位图的移位与按位与，整行一次算完
+bool Bitboard::scan_moves(Line *horizontal, Line *vertical, bool first_only) const
+{
+	memset(horizontal, 0, sizeof(Line) * height_);
+	memset(vertical, 0, sizeof(Line) * height_);
+
+	// 有元素的位置
+	Line occupied[kMaxSize] = { 0 };
+	for (int type = 1; type <= type_num_; ++type)
+	{
+		const Line *rows = &rows_[type * row_stride_ + 2];
+		for (int y = 0; y < height_; ++y)
+		{
+			occupied[y] |= rows[y];
+		}
+	}
+
+	Line any = 0;
+	for (int type = 1; type <= type_num_; ++type)
+	{
+		const Line *rows = &rows_[type * row_stride_ + 2];
+		for (int y = 0; y < height_; ++y)
+		{
+			const Line r = rows[y];
+			const Line up = rows[y + 1];
+			const Line down = rows[y - 1];
+
+			const Line left_two = (r << 1) & (r << 2);
+			const Line right_two = (r >> 1) & (r >> 2);
+			const Line row_any = left_two | right_two | ((r << 1) & (r >> 1));
+			const Line up_two = up & rows[y + 2];
+			const Line down_two = down & rows[y - 2];
+			const Line col_any = up_two | down_two | (up & down);
+
+			// 可以接收该类型的位置
+			const Line target = occupied[y] & ~r;
+
+			const Line from_right = target & (r >> 1) & (left_two | col_any);
+			const Line from_left = target & (r << 1) & (right_two | col_any);
+			const Line from_up = target & up & (row_any | down_two);
+			const Line from_down = target & down & (row_any | up_two);
+
+			horizontal[y] |= from_right | (from_left >> 1);
+			vertical[y] |= from_up;
+			if (y > 0)
+			{
+				vertical[y - 1] |= from_down;
+			}
+
+			any |= from_right | from_left | from_up | from_down;
+			if (first_only && any != 0)
+			{
+				return true;
+			}
+		}
+	}
+	return any != 0;
+}
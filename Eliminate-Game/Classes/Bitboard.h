@@ -0,0 +1,238 @@
+﻿/**
+ * 位棋盘
+ * 每种元素类型按行、按列各保存一份位图，用于快速检测三消
+ */
+
+#ifndef __BITBOARD_H__
+#define __BITBOARD_H__
+
+#include <vector>
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+class Bitboard
+{
+public:
+	typedef uint64_t Line;
+
+	/**
+	 * 最大边长
+	 */
+	static const int kMaxSize = 64;
+
+	/**
+	 * 最少连续数量
+	 */
+	static const int kMatchLength = 3;
+
+public:
+	Bitboard();
+
+	/**
+	 * 重置
+	 */
+	void reset(int width, int height, int type_num);
+
+	/**
+	 * 放置元素
+	 */
+	void set(int x, int y, int type);
+
+	/**
+	 * 移除元素
+	 */
+	void clear(int x, int y, int type);
+
+	/**
+	 * 获取行位图
+	 */
+	Line row(int type, int y) const;
+
+	/**
+	 * 获取列位图
+	 */
+	Line col(int type, int x) const;
+
+	/**
+	 * 查找经过指定位置的连续元素
+	 * @return 按行写入结果，存在可消除的元素返回true
+	 */
+	bool find_match_at(int x, int y, int type, Line *ret) const;
+
+	/**
+	 * 在指定位置放置该类型后是否形成三消
+	 * 不修改位图，位置上原有的其他类型不影响结果
+	 */
+	bool would_match(int x, int y, int type) const;
+
+	/**
+	 * 查找整个棋盘中可消除的元素
+	 * @param ret 按行写入结果，长度不小于棋盘高度
+	 * @return 存在可消除的元素返回true
+	 */
+	bool find_all_matches(Line *ret) const;
+
+	/**
+	 * 查找指定格子中可消除的元素
+	 * 只计算cells中非空的行，开销与改变的行数成正比
+	 * @param cells 按行给出需要检查的格子，长度不小于棋盘高度
+	 * @param ret 按行写入结果，只包含cells中的格子
+	 * @return 存在可消除的元素返回true
+	 */
+	bool find_matches_in(const Line *cells, Line *ret) const;
+
+	/**
+	 * 查找所有可以形成消除的交换
+	 * @param horizontal 按行写入，第x位表示(x, y)与(x + 1, y)交换
+	 * @param vertical 按行写入，第x位表示(x, y)与(x, y + 1)交换
+	 * @return 存在可以形成消除的交换返回true
+	 */
+	bool find_moves(Line *horizontal, Line *vertical) const;
+
+	/**
+	 * 是否存在可以形成消除的交换
+	 */
+	bool has_move() const;
+
+public:
+	/**
+	 * 最低位索引
+	 */
+	static int lowest_bit(Line value);
+
+	/**
+	 * 最高位索引
+	 */
+	static int highest_bit(Line value);
+
+	/**
+	 * 置位数量
+	 */
+	static int bit_count(Line value);
+
+	/**
+	 * 低位连续1的数量
+	 */
+	static int trailing_ones(Line value);
+
+	/**
+	 * 高位连续1的数量
+	 */
+	static int leading_ones(Line value);
+
+	/**
+	 * 生成[begin, begin + length)区间掩码
+	 */
+	static Line range_mask(int begin, int length);
+
+private:
+	/**
+	 * 扫描可以形成消除的交换
+	 * @param first_only 找到第一个后立即返回
+	 */
+	bool scan_moves(Line *horizontal, Line *vertical, bool first_only) const;
+
+private:
+	int						width_;
+	int						height_;
+	int						type_num_;
+	int						row_stride_;
+	std::vector<Line>		rows_;		// 每种类型 height + 4 行，前后各填充两行空行
+	std::vector<Line>		cols_;		// 每种类型 width 列
+};
+
+inline Bitboard::Line Bitboard::row(int type, int y) const
+{
+	return rows_[type * row_stride_ + y + 2];
+}
+
+inline Bitboard::Line Bitboard::col(int type, int x) const
+{
+	return cols_[type * width_ + x];
+}
+
+inline void Bitboard::set(int x, int y, int type)
+{
+	rows_[type * row_stride_ + y + 2] |= Line(1) << x;
+	cols_[type * width_ + x] |= Line(1) << y;
+}
+
+inline void Bitboard::clear(int x, int y, int type)
+{
+	rows_[type * row_stride_ + y + 2] &= ~(Line(1) << x);
+	cols_[type * width_ + x] &= ~(Line(1) << y);
+}
+
+inline int Bitboard::lowest_bit(Line value)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index = 0;
+	_BitScanForward64(&index, value);
+	return static_cast<int>(index);
+#elif defined(__GNUC__)
+	return __builtin_ctzll(value);
+#else
+	int index = 0;
+	while ((value & 1) == 0)
+	{
+		value >>= 1;
+		++index;
+	}
+	return index;
+#endif
+}
+
+inline int Bitboard::highest_bit(Line value)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index = 0;
+	_BitScanReverse64(&index, value);
+	return static_cast<int>(index);
+#elif defined(__GNUC__)
+	return 63 - __builtin_clzll(value);
+#else
+	int index = 63;
+	while ((value & (Line(1) << index)) == 0)
+	{
+		--index;
+	}
+	return index;
+#endif
+}
+
+inline int Bitboard::bit_count(Line value)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	return static_cast<int>(__popcnt64(value));
+#elif defined(__GNUC__)
+	return __builtin_popcountll(value);
+#else
+	int count = 0;
+	while (value)
+	{
+		value &= value - 1;
+		++count;
+	}
+	return count;
+#endif
+}
+
+inline int Bitboard::trailing_ones(Line value)
+{
+	return ~value == 0 ? 64 : lowest_bit(~value);
+}
+
+inline int Bitboard::leading_ones(Line value)
+{
+	return ~value == 0 ? 64 : 63 - highest_bit(~value);
+}
+
+inline Bitboard::Line Bitboard::range_mask(int begin, int length)
+{
+	return (length >= 64 ? ~Line(0) : ((Line(1) << length) - 1)) << begin;
+}
+
+#endif
@@ -0,0 +1,308 @@
+﻿#include "BoardRenderer.h"
+
+#include <cstring>
+using namespace cocos2d;
+
+
+namespace
+{
+	// 隐藏的四边形退化为一个点
+	const V3F_C4B_T2F_Quad kEmptyQuad = {};
+
+	// 逐字节比较四边形
+	bool is_same_quad(const V3F_C4B_T2F_Quad &a, const V3F_C4B_T2F_Quad &b)
+	{
+		return memcmp(&a, &b, sizeof(V3F_C4B_T2F_Quad)) == 0;
+	}
+}
+
+BoardRenderer::BoardRenderer()
+	: texture_(nullptr)
+	, frame_sprite_(nullptr)
+	, blend_func_(BlendFunc::ALPHA_PREMULTIPLIED)
+	, floor_num_(0)
+	, dirty_begin_(0)
+	, dirty_end_(0)
+	, buffer_capacity_(0)
+{
+	buffers_[0] = buffers_[1] = 0;
+}
+
+BoardRenderer::~BoardRenderer()
+{
+	if (buffers_[0] != 0)
+	{
+		glDeleteBuffers(2, buffers_);
+	}
+	CC_SAFE_RELEASE(frame_sprite_);
+	CC_SAFE_RELEASE(texture_);
+}
+
+BoardRenderer* BoardRenderer::create(Texture2D *texture)
+{
+	BoardRenderer *renderer = new (std::nothrow) BoardRenderer();
+	if (renderer && renderer->init_with_texture(texture))
+	{
+		renderer->autorelease();
+		return renderer;
+	}
+	CC_SAFE_DELETE(renderer);
+	return nullptr;
+}
+
+bool BoardRenderer::init_with_texture(Texture2D *texture)
+{
+	if (texture == nullptr || !Node::init())
+	{
+		return false;
+	}
+
+	texture_ = texture;
+	texture_->retain();
+	frame_sprite_ = Sprite::createWithTexture(texture_);
+	frame_sprite_->retain();
+	blend_func_ = texture_->hasPremultipliedAlpha() ? BlendFunc::ALPHA_PREMULTIPLIED : BlendFunc::ALPHA_NON_PREMULTIPLIED;
+	setGLProgramState(GLProgramState::getOrCreateWithGLProgramName(GLProgram::SHADER_NAME_POSITION_TEXTURE_COLOR));
+
+#if CC_ENABLE_CACHE_TEXTURE_DATA
+	// 渲染环境重建后缓冲失效，下次绘制时重新创建
+	auto listener = EventListenerCustom::create(EVENT_RENDERER_RECREATED, [this](EventCustom *event)
+	{
+		buffers_[0] = buffers_[1] = 0;
+		buffer_capacity_ = 0;
+	});
+	_eventDispatcher->addEventListenerWithSceneGraphPriority(listener, this);
+#endif
+
+	return true;
+}
+
+// 设置地板数量
+void BoardRenderer::reset_floors(size_t num)
+{
+	CCASSERT(num + pieces_.size() <= kMaxQuads, "too many quads");
+	quads_.erase(quads_.begin(), quads_.begin() + floor_num_);
+	quads_.insert(quads_.begin(), num, kEmptyQuad);
+	floor_num_ = num;
+
+	// 元素四边形的位置改变，全部重新写入
+	for (size_t i = 0; i < pieces_.size(); ++i)
+	{
+		write_piece_quad(i);
+	}
+	mark_dirty(0, quads_.size());
+}
+
+// 设置地板
+void BoardRenderer::set_floor(size_t idx, const Vec2 &position, SpriteFrame *frame)
+{
+	CCASSERT(idx < floor_num_, "");
+	CCASSERT(frame == nullptr || frame->getTexture() == texture_, "floor must use the board texture");
+
+	V3F_C4B_T2F_Quad &quad = quads_[idx];
+	if (frame == nullptr)
+	{
+		quad = kEmptyQuad;
+	}
+	else
+	{
+		// 借用精灵计算纹理坐标，处理图集中的旋转和裁剪
+		frame_sprite_->setSpriteFrame(frame);
+		const Vec2 origin = position - frame_sprite_->getAnchorPointInPoints();
+		quad = frame_sprite_->getQuad();
+		for (auto vertex : { &quad.bl, &quad.br, &quad.tl, &quad.tr })
+		{
+			vertex->vertices.x += origin.x;
+			vertex->vertices.y += origin.y;
+		}
+	}
+	mark_dirty(idx, idx + 1);
+}
+
+// 添加元素
+void BoardRenderer::add_piece(Sprite *piece)
+{
+	CCASSERT(piece != nullptr && piece->getTexture() == texture_, "piece must use the board texture");
+	CCASSERT(floor_num_ + pieces_.size() < kMaxQuads, "too many quads");
+
+	addChild(piece);
+
+	PieceState state = {};
+	state.sprite = piece;
+	pieces_.push_back(state);
+	quads_.push_back(kEmptyQuad);
+	write_piece_quad(pieces_.size() - 1);
+}
+
+// 元素四边形的位置
+inline size_t BoardRenderer::piece_quad_index(size_t idx) const
+{
+	return floor_num_ + idx;
+}
+
+// 标记需要上传的四边形
+void BoardRenderer::mark_dirty(size_t begin, size_t end)
+{
+	if (dirty_begin_ == dirty_end_)
+	{
+		dirty_begin_ = begin;
+		dirty_end_ = end;
+	}
+	else
+	{
+		dirty_begin_ = std::min(dirty_begin_, begin);
+		dirty_end_ = std::max(dirty_end_, end);
+	}
+}
+
+// 同步元素状态
+// 元素的动作只修改位置、缩放和颜色，逐个比较比遍历节点树便宜得多
+void BoardRenderer::update_pieces()
+{
+	for (size_t i = 0; i < pieces_.size(); ++i)
+	{
+		const PieceState &state = pieces_[i];
+		const Sprite *sprite = state.sprite;
+		if (state.visible != sprite->isVisible()
+			|| (state.visible
+				&& (state.position != sprite->getPosition()
+				|| state.scale_x != sprite->getScaleX()
+				|| state.scale_y != sprite->getScaleY()
+				|| !is_same_quad(state.source, sprite->getQuad()))))
+		{
+			write_piece_quad(i);
+		}
+	}
+}
+
+// 写入元素四边形
+void BoardRenderer::write_piece_quad(size_t idx)
+{
+	PieceState &state = pieces_[idx];
+	const Sprite *sprite = state.sprite;
+	state.visible = sprite->isVisible();
+	state.position = sprite->getPosition();
+	state.scale_x = sprite->getScaleX();
+	state.scale_y = sprite->getScaleY();
+	state.source = sprite->getQuad();
+
+	const size_t quad_idx = piece_quad_index(idx);
+	V3F_C4B_T2F_Quad &quad = quads_[quad_idx];
+	if (!state.visible)
+	{
+		quad = kEmptyQuad;
+	}
+	else
+	{
+		// 以锚点为中心缩放
+		const Vec2 &anchor = sprite->getAnchorPointInPoints();
+		quad = state.source;
+		for (auto vertex : { &quad.bl, &quad.br, &quad.tl, &quad.tr })
+		{
+			vertex->vertices.x = state.position.x + (vertex->vertices.x - anchor.x) * state.scale_x;
+			vertex->vertices.y = state.position.y + (vertex->vertices.y - anchor.y) * state.scale_y;
+		}
+	}
+	mark_dirty(quad_idx, quad_idx + 1);
+}
+
+// 重建顶点缓冲
+void BoardRenderer::rebuild_buffers()
+{
+	if (buffers_[0] == 0)
+	{
+		glGenBuffers(2, buffers_);
+	}
+
+	buffer_capacity_ = std::max(quads_.size(), buffer_capacity_ * 2);
+	if (buffer_capacity_ > kMaxQuads)
+	{
+		buffer_capacity_ = kMaxQuads;
+	}
+
+	std::vector<GLushort> indices(buffer_capacity_ * 6);
+	for (size_t i = 0; i < buffer_capacity_; ++i)
+	{
+		indices[i * 6 + 0] = static_cast<GLushort>(i * 4 + 0);
+		indices[i * 6 + 1] = static_cast<GLushort>(i * 4 + 1);
+		indices[i * 6 + 2] = static_cast<GLushort>(i * 4 + 2);
+		indices[i * 6 + 3] = static_cast<GLushort>(i * 4 + 3);
+		indices[i * 6 + 4] = static_cast<GLushort>(i * 4 + 2);
+		indices[i * 6 + 5] = static_cast<GLushort>(i * 4 + 1);
+	}
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers_[1]);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort) * indices.size(), indices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	glBindBuffer(GL_ARRAY_BUFFER, buffers_[0]);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(V3F_C4B_T2F_Quad) * buffer_capacity_, nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	mark_dirty(0, quads_.size());
+}
+
+// 遍历
+// 不遍历子节点，元素由本节点统一绘制
+void BoardRenderer::visit(Renderer *renderer, const Mat4 &parent_transform, uint32_t parent_flags)
+{
+	if (!_visible)
+	{
+		return;
+	}
+
+	const uint32_t flags = processParentFlags(parent_transform, parent_flags);
+	update_pieces();
+	draw(renderer, _modelViewTransform, flags);
+}
+
+// 绘制
+void BoardRenderer::draw(Renderer *renderer, const Mat4 &transform, uint32_t flags)
+{
+	if (quads_.empty())
+	{
+		return;
+	}
+
+	command_.init(_globalZOrder);
+	command_.func = CC_CALLBACK_0(BoardRenderer::on_draw, this, transform, flags);
+	renderer->addCommand(&command_);
+}
+
+// 渲染
+void BoardRenderer::on_draw(const Mat4 &transform, uint32_t flags)
+{
+	if (quads_.size() > buffer_capacity_)
+	{
+		rebuild_buffers();
+	}
+
+	auto program = getGLProgram();
+	program->use();
+	program->setUniformsForBuiltins(transform);
+	GL::blendFunc(blend_func_.src, blend_func_.dst);
+	GL::bindTexture2D(texture_->getName());
+
+	glBindBuffer(GL_ARRAY_BUFFER, buffers_[0]);
+
+	// 只上传变化的部分
+	if (dirty_begin_ < dirty_end_)
+	{
+		glBufferSubData(GL_ARRAY_BUFFER, sizeof(V3F_C4B_T2F_Quad) * dirty_begin_,
+			sizeof(V3F_C4B_T2F_Quad) * (dirty_end_ - dirty_begin_), &quads_[dirty_begin_]);
+		dirty_begin_ = dirty_end_ = 0;
+	}
+
+	GL::enableVertexAttribs(GL::VERTEX_ATTRIB_FLAG_POS_COLOR_TEX);
+	glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(V3F_C4B_T2F), (GLvoid *)offsetof(V3F_C4B_T2F, vertices));
+	glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(V3F_C4B_T2F), (GLvoid *)offsetof(V3F_C4B_T2F, colors));
+	glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_TEX_COORD, 2, GL_FLOAT, GL_FALSE, sizeof(V3F_C4B_T2F), (GLvoid *)offsetof(V3F_C4B_T2F, texCoords));
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers_[1]);
+	glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(quads_.size() * 6), GL_UNSIGNED_SHORT, nullptr);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	CC_INCREMENT_GL_DRAWN_BATCHES_AND_VERTICES(1, quads_.size() * 4);
+	CHECK_GL_ERROR_DEBUG();
+}
@@ -0,0 +1,109 @@
+﻿/**
+ * 棋盘渲染节点
+ * 每个地板和元素在一个常驻的顶点缓冲中占一个四边形，整个棋盘作为一个自定义命令提交
+ * 元素精灵作为子节点只用于承载动作，不参与遍历和矩阵计算，
+ * 每帧比较精灵的位置、缩放、颜色和纹理坐标，只上传变化的四边形
+ * 不支持元素旋转和倾斜
+ */
+
+#ifndef __BOARDRENDERER_H__
+#define __BOARDRENDERER_H__
+
+#include <vector>
+#include "cocos2d.h"
+
+class BoardRenderer : public cocos2d::Node
+{
+	static const size_t kMaxQuads = 65536 / 4;		// 顶点索引为16位
+
+	/**
+	 * 元素上次写入的状态
+	 */
+	struct PieceState
+	{
+		cocos2d::Sprite*			sprite;
+		cocos2d::Vec2				position;
+		float						scale_x;
+		float						scale_y;
+		bool						visible;
+		cocos2d::V3F_C4B_T2F_Quad	source;			// 精灵自身坐标系下的四边形
+	};
+
+public:
+	BoardRenderer();
+
+	~BoardRenderer();
+
+	static BoardRenderer* create(cocos2d::Texture2D *texture);
+
+	bool init_with_texture(cocos2d::Texture2D *texture);
+
+public:
+	/**
+	 * 设置地板数量，所有地板被隐藏
+	 */
+	void reset_floors(size_t num);
+
+	/**
+	 * 设置地板
+	 * @param frame 为nullptr时隐藏
+	 */
+	void set_floor(size_t idx, const cocos2d::Vec2 &position, cocos2d::SpriteFrame *frame);
+
+	/**
+	 * 添加元素
+	 * 精灵必须使用同一纹理，绘制在所有地板之上，添加后不能移除
+	 */
+	void add_piece(cocos2d::Sprite *piece);
+
+public:
+	virtual void visit(cocos2d::Renderer *renderer, const cocos2d::Mat4 &parent_transform, uint32_t parent_flags) override;
+
+	virtual void draw(cocos2d::Renderer *renderer, const cocos2d::Mat4 &transform, uint32_t flags) override;
+
+private:
+	/**
+	 * 元素四边形的位置
+	 */
+	size_t piece_quad_index(size_t idx) const;
+
+	/**
+	 * 标记需要上传的四边形
+	 */
+	void mark_dirty(size_t begin, size_t end);
+
+	/**
+	 * 同步元素状态
+	 */
+	void update_pieces();
+
+	/**
+	 * 写入元素四边形
+	 */
+	void write_piece_quad(size_t idx);
+
+	/**
+	 * 重建顶点缓冲
+	 */
+	void rebuild_buffers();
+
+	/**
+	 * 渲染
+	 */
+	void on_draw(const cocos2d::Mat4 &transform, uint32_t flags);
+
+private:
+	cocos2d::Texture2D*							texture_;
+	cocos2d::Sprite*							frame_sprite_;		// 用于计算地板的四边形
+	cocos2d::BlendFunc							blend_func_;
+	cocos2d::CustomCommand						command_;
+	size_t										floor_num_;
+	std::vector<PieceState>						pieces_;
+	std::vector<cocos2d::V3F_C4B_T2F_Quad>		quads_;				// 地板在前，元素在后
+	size_t										dirty_begin_;
+	size_t										dirty_end_;
+	GLuint										buffers_[2];		// 顶点和索引
+	size_t										buffer_capacity_;	// 缓冲能容纳的四边形数量
+};
+
+#endif
@@ -1,65 +1,271 @@
 ﻿#include "CheckerboardCache.h"
 
 #include "cocos2d.h"
-#include "json/document.h"
 using namespace cocos2d;
 
 
 CheckerboardCache::CheckerboardCache()
+	: stop_(false)
 {
 
 }
 
 CheckerboardCache::~CheckerboardCache()
 {
-
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	cond_.notify_all();
+	if (worker_.joinable())
+	{
+		worker_.join();
+	}
 }
 
 // 添加棋盘配置
+// TMX解析依赖引擎的自动释放池，只能在主线程进行
 void CheckerboardCache::add_checkerboard_config(const std::string &filename)
 {
-	auto itr = checkerboard_.find(filename);
-	if (itr == checkerboard_.end())
 	{
-		Data data = FileUtils::getInstance()->getDataFromFile(filename);
-		if (!data.isNull())
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (checkerboard_.find(filename) != checkerboard_.end())
+		{
+			return;
+		}
+	}
+
+	auto map_info = TMXMapInfo::create(filename);
+	if (map_info != nullptr)
+	{
+		auto layers = map_info->getLayers();
+		CCAssert(!layers.empty(), "");
+		auto tiles = layers.front()->_tiles;
+		auto layer_size = layers.front()->_layerSize;
+
+		auto config = std::make_shared<Config>();
+		config->width = layer_size.width;
+		config->height = layer_size.height;
+		config->layout.resize(config->width * config->height);
+		config->type_num = atoi(layers.front()->_name.c_str());
+
+		// 坐标系转换
+		for (int row = 0; row < config->height; ++row)
 		{
-			rapidjson::Document doc;
-			doc.Parse<0>(std::string((const char *)data.getBytes(), data.getSize()).c_str());
-
-			auto map_info = TMXMapInfo::create(filename);
-			auto layers = map_info->getLayers();
-			CCAssert(!layers.empty(), "");
-			auto tiles = layers.front()->_tiles;
-			auto layer_size = layers.front()->_layerSize;
-
-			Config config;
-			config.width = layer_size.width;
-			config.height = layer_size.height;
-			config.layout.resize(config.width * config.height);
-			config.type_num = atoi(layers.front()->_name.c_str());
-
-			// 坐标系转换
-			for (int row = 0; row < config.height; ++row)
+			for (int col = 0; col < config->width; ++col)
 			{
-				for (int col = 0; col < config.width; ++col)
-				{
-					config.layout[row * config.width + col] = tiles[(config.height - row - 1) * config.width + col] != 0;
-				}
+				config->layout[row * config->width + col] = tiles[(config->height - row - 1) * config->width + col] != 0;
 			}
-
-			checkerboard_.insert(std::make_pair(filename, config));
 		}
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		checkerboard_.insert(std::make_pair(filename, config));
 	}
 }
 
 // 获取棋盘配置
-bool CheckerboardCache::get_checkerboard_config(const std::string &filename, Config &ret) const
+CheckerboardCache::ConfigPtr CheckerboardCache::get_checkerboard_config(const std::string &filename) const
 {
+	std::lock_guard<std::mutex> lock(mutex_);
 	auto itr = checkerboard_.find(filename);
-	if (itr != checkerboard_.end())
+	return itr == checkerboard_.end() ? nullptr : itr->second;
+}
+
+// 加载关卡包
+bool CheckerboardCache::load_level_archive(const std::string &filename)
+{
+	const std::string path = FileUtils::getInstance()->fullPathForFilename(filename);
+	if (path.empty())
+	{
+		return false;
+	}
+
+	auto archive = std::make_shared<LevelArchive>();
+	if (!archive->open(path))
+	{
+		Data data = FileUtils::getInstance()->getDataFromFile(path);
+		if (data.isNull() || !archive->open_memory(data.getBytes(), data.getSize()))
+		{
+			return false;
+		}
+	}
+
+	// 后台线程持有旧关卡包直到解码结束，排队中的关卡在新关卡包中重新解码
+	std::lock_guard<std::mutex> lock(mutex_);
+	archive_ = archive;
+	levels_.clear();
+	return true;
+}
+
+// 关卡包中的关卡数量
+size_t CheckerboardCache::get_level_num() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return archive_ != nullptr ? archive_->level_num() : 0;
+}
+
+// 从关卡包获取棋盘配置
+CheckerboardCache::ConfigPtr CheckerboardCache::get_checkerboard_config(unsigned int level)
+{
+	std::shared_ptr<const LevelArchive> archive;
 	{
-		ret = itr->second;
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto itr = levels_.find(level);
+		if (itr != levels_.end())
+		{
+			return itr->second;
+		}
+		archive = archive_;
 	}
-	return itr == checkerboard_.end() ? false : true;
-}
\ No newline at end of file
+
+	if (archive == nullptr)
+	{
+		return nullptr;
+	}
+	return publish_level(archive, level, decode_level(*archive, level));
+}
+
+// 预先解码关卡
+void CheckerboardCache::prefetch_levels(unsigned int first, unsigned int count)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (archive_ == nullptr)
+		{
+			return;
+		}
+
+		for (unsigned int level = first; level < first + count; ++level)
+		{
+			if (levels_.find(level) == levels_.end())
+			{
+				enqueue_level(level);
+			}
+		}
+	}
+	cond_.notify_one();
+}
+
+// 异步获取棋盘配置
+void CheckerboardCache::load_checkerboard_config_async(unsigned int level, const LoadCallback &callback)
+{
+	ConfigPtr config;
+	bool queued = false;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto itr = levels_.find(level);
+		if (itr != levels_.end())
+		{
+			config = itr->second;
+		}
+		else if (archive_ != nullptr)
+		{
+			callbacks_[level].push_back(callback);
+			enqueue_level(level);
+			queued = true;
+		}
+	}
+
+	if (queued)
+	{
+		cond_.notify_one();
+	}
+	else
+	{
+		callback(config);
+	}
+}
+
+// 解码关卡
+CheckerboardCache::ConfigPtr CheckerboardCache::decode_level(const LevelArchive &archive, unsigned int level)
+{
+	LevelArchive::Level view;
+	if (!archive.find_level(level, view))
+	{
+		return nullptr;
+	}
+
+	auto config = std::make_shared<Config>();
+	view.to_config(*config);
+	return config;
+}
+
+// 发布解码结果
+CheckerboardCache::ConfigPtr CheckerboardCache::publish_level(const std::shared_ptr<const LevelArchive> &archive, unsigned int level, const ConfigPtr &config)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (archive != archive_ || config == nullptr)
+	{
+		return config;
+	}
+
+	// 其他线程先完成时使用已经发布的配置，保证同一关卡只有一份
+	return levels_.insert(std::make_pair(level, config)).first->second;
+}
+
+// 加入后台队列
+void CheckerboardCache::enqueue_level(unsigned int level)
+{
+	if (queued_.insert(level).second)
+	{
+		queue_.push_back(level);
+	}
+
+	if (!worker_.joinable())
+	{
+		worker_ = std::thread(&CheckerboardCache::run_prefetch, this);
+	}
+}
+
+// 后台线程
+void CheckerboardCache::run_prefetch()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (true)
+	{
+		cond_.wait(lock, [this]()
+		{
+			return stop_ || !queue_.empty();
+		});
+
+		if (stop_)
+		{
+			break;
+		}
+
+		const unsigned int level = queue_.front();
+		queue_.pop_front();
+		auto archive = archive_;
+
+		// 解码期间不持有锁，主线程查询不会被阻塞
+		ConfigPtr config;
+		auto itr = levels_.find(level);
+		if (itr != levels_.end())
+		{
+			config = itr->second;
+		}
+		else
+		{
+			lock.unlock();
+			config = publish_level(archive, level, decode_level(*archive, level));
+			lock.lock();
+		}
+		queued_.erase(level);
+
+		// 回调交给主线程执行
+		auto callbacks = callbacks_.find(level);
+		if (callbacks != callbacks_.end())
+		{
+			auto pending = std::make_shared<std::vector<LoadCallback>>();
+			pending->swap(callbacks->second);
+			callbacks_.erase(callbacks);
+			Director::getInstance()->getScheduler()->performFunctionInCocosThread([pending, config]()
+			{
+				for (auto &callback : *pending)
+				{
+					callback(config);
+				}
+			});
+		}
+	}
+}
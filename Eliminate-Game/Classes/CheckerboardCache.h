@@ -1,21 +1,36 @@
 ﻿#ifndef __CHECKERBOARDCACHE_H__
 #define __CHECKERBOARDCACHE_H__
 
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <functional>
 #include <unordered_map>
+#include <unordered_set>
+#include <condition_variable>
 #include "Singleton.h"
+#include "LevelArchive.h"
+#include "CheckerboardConfig.h"
 
 class CheckerboardCache : public Singleton < CheckerboardCache >
 {
 	SINGLETON(CheckerboardCache);
 
 public:
-	struct Config
-	{
-		int					height;		// 棋盘高度
-		int					width;		// 棋盘宽度
-		int					type_num;	// 类型数量
-		std::vector<bool>	layout;		// 棋盘布局
-	};
+	typedef CheckerboardConfig Config;
+
+	/**
+	 * 共享的只读配置，发布后不再修改，可以在任意线程读取
+	 */
+	typedef std::shared_ptr<const Config> ConfigPtr;
+
+	/**
+	 * 异步加载回调，在主线程调用
+	 */
+	typedef std::function<void(const ConfigPtr &config)> LoadCallback;
 
 public:
 	/**
@@ -25,11 +40,75 @@ public:
 
 	/**
 	 * 获取棋盘配置
+	 * @return 找不到返回nullptr
+	 */
+	ConfigPtr get_checkerboard_config(const std::string &filename) const;
+
+	/**
+	 * 加载关卡包
+	 * 优先映射文件，无法映射时(如安卓包内资源)读取到内存
+	 * 之前从关卡包解码的配置会被丢弃，已经取得的配置仍然有效
+	 */
+	bool load_level_archive(const std::string &filename);
+
+	/**
+	 * 关卡包中的关卡数量
+	 */
+	size_t get_level_num() const;
+
+	/**
+	 * 从关卡包获取棋盘配置
+	 * 尚未解码时在当前线程解码
+	 * @return 找不到返回nullptr
+	 */
+	ConfigPtr get_checkerboard_config(unsigned int level);
+
+	/**
+	 * 在后台线程预先解码[first, first + count)的关卡
+	 * 已经解码或正在排队的关卡不会重复解码
+	 */
+	void prefetch_levels(unsigned int first, unsigned int count);
+
+	/**
+	 * 异步获取关卡包中的棋盘配置
+	 * 已经解码时立即回调，否则在后台解码完成后于主线程回调，找不到时回调参数为nullptr
+	 */
+	void load_checkerboard_config_async(unsigned int level, const LoadCallback &callback);
+
+private:
+	/**
+	 * 解码关卡
+	 */
+	static ConfigPtr decode_level(const LevelArchive &archive, unsigned int level);
+
+	/**
+	 * 发布解码结果
+	 * 关卡包在解码期间被替换时丢弃结果
+	 * @return 当前应使用的配置
+	 */
+	ConfigPtr publish_level(const std::shared_ptr<const LevelArchive> &archive, unsigned int level, const ConfigPtr &config);
+
+	/**
+	 * 加入后台队列，调用时需持有锁
+	 */
+	void enqueue_level(unsigned int level);
+
+	/**
+	 * 后台线程
 	 */
-	bool get_checkerboard_config(const std::string &filename, Config &ret) const;
+	void run_prefetch();
 
 private:
-	std::unordered_map<std::string, Config> checkerboard_;
+	mutable std::mutex										mutex_;
+	std::condition_variable									cond_;
+	std::thread												worker_;			// 第一次预取时启动
+	bool													stop_;
+	std::shared_ptr<const LevelArchive>						archive_;
+	std::deque<unsigned int>								queue_;
+	std::unordered_set<unsigned int>						queued_;
+	std::unordered_map<unsigned int, ConfigPtr>				levels_;
+	std::unordered_map<unsigned int, std::vector<LoadCallback>>	callbacks_;
+	std::unordered_map<std::string, ConfigPtr>				checkerboard_;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,18 @@
+﻿#ifndef __CHECKERBOARDCONFIG_H__
+#define __CHECKERBOARDCONFIG_H__
+
+#include <vector>
+
+/**
+ * 棋盘配置
+ * 不依赖引擎，供游戏逻辑与无界面工具共用
+ */
+struct CheckerboardConfig
+{
+	int					height;		// 棋盘高度
+	int					width;		// 棋盘宽度
+	int					type_num;	// 类型数量
+	std::vector<bool>	layout;		// 棋盘布局
+};
+
+#endif
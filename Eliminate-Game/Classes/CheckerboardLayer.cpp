@@ -1,15 +1,26 @@
 ﻿#include "CheckerboardLayer.h"
 
+#include <ctime>
 #include "Element.h"
+#include "BoardRenderer.h"
 #include "VisibleRect.h"
 using namespace cocos2d;
 
+namespace
+{
+	const float kSwapDuration = 0.25f;
+	const float kAutofillDuration = 0.1f;		// 每移动一格
+}
 
 CheckerboardLayer::CheckerboardLayer()
 	: handle_num_(0)
 	, touch_lock_(false)
-	, batch_node_(nullptr)
+	, element_num_(0)
+	, board_(nullptr)
 	, previous_selected_(GameLogic::Vec2::invalid())
+	, swap_pending_(0)
+	, playback_mode_(PlaybackMode::NORMAL)
+	, playback_speed_(1.0f)
 {
 	
 }
@@ -26,8 +37,8 @@ bool CheckerboardLayer::init()
 		return false;
 	}
 
-	batch_node_ = SpriteBatchNode::create("img/elements.png");
-	addChild(batch_node_);
+	board_ = BoardRenderer::create(Director::getInstance()->getTextureCache()->addImage("img/elements.png"));
+	addChild(board_);
 
 	// 添加触摸事件
 	auto listener = EventListenerTouchOneByOne::create();
@@ -42,33 +53,98 @@ bool CheckerboardLayer::init()
 	return true;
 }
 
-// 初始化地板
-void CheckerboardLayer::init_floors()
+// 初始化元素
+void CheckerboardLayer::init_elements()
 {
-	for (auto floor_ptr : floors_)
+	for (auto &element : elements_)
 	{
-		floor_ptr->setVisible(false);
+		if (element != nullptr)
+		{
+			element->setVisible(false);
+			free_elements_.push_back(element);
+			element = nullptr;
+		}
 	}
+	element_num_ = 0;
 }
 
-// 初始化元素
-void CheckerboardLayer::init_elements()
+// 获取格子上的元素
+inline Element*& CheckerboardLayer::element_at(const GameLogic::Vec2 &pos)
 {
-	for (auto elment : elements_)
-	{
-		elment.second->setVisible(false);
-		free_elements_.push_back(elment.second);
-	}
-	elements_.clear();
+	assert(pos.x >= 0 && pos.x < logic_.get_checkerboard_width() && pos.y >= 0 && pos.y < logic_.get_checkerboard_height());
+	return elements_[pos.y * logic_.get_checkerboard_width() + pos.x];
 }
 
 // 开始游戏
-void CheckerboardLayer::start_game(const CheckerboardCache::Config &config)
+void CheckerboardLayer::start_game(const CheckerboardCache::Config &config, unsigned int level)
 {
-	init_floors();
 	init_elements();
+	elements_.assign(config.width * config.height, nullptr);
+	board_->reset_floors(config.width * config.height);
 	handle_num_ = 0;
-	logic_.start_game(config);
+	const uint64_t seed = static_cast<uint64_t>(time(nullptr));
+	replay_.reset(level, seed);
+	logic_.start_game(config, seed);
+	if (playback_mode_ == PlaybackMode::SKIP)
+	{
+		skip_action_groups();
+	}
+}
+
+// 设置播放模式
+void CheckerboardLayer::set_playback_mode(PlaybackMode mode)
+{
+	playback_mode_ = mode;
+	if (playback_mode_ == PlaybackMode::SKIP && handle_num_ == 0 && swap_pending_ == 0 && logic_.get_action_group_num() > 0)
+	{
+		skip_action_groups();
+	}
+}
+
+// 设置播放速度倍数
+void CheckerboardLayer::set_playback_speed(float speed)
+{
+	CCAssert(speed > 0, "");
+	playback_speed_ = speed;
+}
+
+// 是否空闲
+bool CheckerboardLayer::is_idle() const
+{
+	return !touch_lock_ && handle_num_ == 0 && logic_.get_action_group_num() == 0;
+}
+
+// 请求交换元素
+bool CheckerboardLayer::request_swap(const GameLogic::Vec2 &a, const GameLogic::Vec2 &b)
+{
+	if (touch_lock_ || !logic_.is_in_checkerboard(a) || !logic_.is_in_checkerboard(b)
+		|| element_at(a) == nullptr || element_at(b) == nullptr || !logic_.is_adjacent(a, b))
+	{
+		return false;
+	}
+
+	// 无法记录的交换不执行，否则对局记录与实际对局不一致
+	if (!replay_.add_swap(a, b, logic_.get_checkerboard_width()))
+	{
+		return false;
+	}
+
+	touch_lock_ = true;
+	swap_element(a, b);
+	return true;
+}
+
+// 按播放速度换算动作时长
+// 跳过模式下动作在下一帧完成
+float CheckerboardLayer::scaled_duration(float duration) const
+{
+	return playback_mode_ == PlaybackMode::SKIP ? 0.0f : duration / playback_speed_;
+}
+
+// 获取对局记录
+const Replay& CheckerboardLayer::get_replay() const
+{
+	return replay_;
 }
 
 // 获取起点坐标
@@ -85,24 +161,22 @@ Vec2 CheckerboardLayer::convert_to_world_pos(const GameLogic::Vec2 &pos) const
 }
 
 // 转换到棋盘坐标
+// convert_to_world_pos的逆运算，格子范围为[起点, 起点 + 尺寸)
 GameLogic::Vec2 CheckerboardLayer::convert_to_checkerboard_pos(const cocos2d::Vec2 &position) const
 {
-	Vec2 start_point = get_start_point();
-	for (int row = 0; row < logic_.get_checkerboard_height(); ++row)
+	Vec2 offset = position - get_start_point();
+	if (offset.x < 0 || offset.y < 0)
 	{
-		for (int col = 0; col < logic_.get_checkerboard_width(); ++col)
-		{
-			float frist_col = start_point.x + col * kElementWidth;
-			float last_col = start_point.x + (col + 1) * kElementWidth;
-			float frist_row = start_point.y + row * kElementHeight;
-			float last_row = start_point.y + (row + 1) * kElementHeight;
-			if (position.x >= frist_col && position.x < last_col && position.y >= frist_row && position.y < last_row)
-			{
-				return GameLogic::Vec2(col, row);
-			}
-		}
+		return GameLogic::Vec2::invalid();
 	}
-	return GameLogic::Vec2::invalid();
+
+	const int col = static_cast<int>(offset.x / kElementWidth);
+	const int row = static_cast<int>(offset.y / kElementHeight);
+	if (col >= logic_.get_checkerboard_width() || row >= logic_.get_checkerboard_height())
+	{
+		return GameLogic::Vec2::invalid();
+	}
+	return GameLogic::Vec2(col, row);
 }
 
 // 更新动作
@@ -115,9 +189,30 @@ void CheckerboardLayer::on_update_action()
 // 执行动作
 void CheckerboardLayer::run_action_group()
 {
+	// 跳过模式等逻辑计算结束后一次刷新
+	if (playback_mode_ == PlaybackMode::SKIP)
+	{
+		return;
+	}
+
+	if (playback_mode_ == PlaybackMode::MERGED && handle_num_ == 0 && logic_.get_action_group_num() > 0)
+	{
+		const GameLogic::ActionType type = logic_.peek_action_group().front().type;
+		if (type == GameLogic::ActionType::REMOVE)
+		{
+			run_merged_eliminate();
+			return;
+		}
+		else if (type == GameLogic::ActionType::AUTOFILL || type == GameLogic::ActionType::GENERATE)
+		{
+			run_merged_autofill();
+			return;
+		}
+	}
+
 	if (handle_num_ == 0 && logic_.get_action_group_num() > 0)
 	{
-		std::vector<GameLogic::Action> action_group = logic_.take_action_group_from_queue();
+		GameLogic::ActionGroup action_group = logic_.take_action_group_from_queue();
 		for (size_t i = 0; i < action_group.size(); ++i)
 		{
 			switch (action_group[i].type)
@@ -152,29 +247,105 @@ void CheckerboardLayer::run_action_group()
 					on_element_autofill(action_group[i].source, action_group[i].target);
 					break;
 				}
+				// 重排棋盘
+				case GameLogic::ActionType::RESHUFFLE:
+				{
+					init_elements();
+					logic_.visit_checkerboard(std::bind(&CheckerboardLayer::on_refresh_checkerboard, this, std::placeholders::_1, std::placeholders::_2));
+					break;
+				}
 			}
 		}
 	}
 }
 
+// 合并播放连续的消除组
+void CheckerboardLayer::run_merged_eliminate()
+{
+	while (logic_.get_action_group_num() > 0 && logic_.peek_action_group().front().type == GameLogic::ActionType::REMOVE)
+	{
+		for (auto &action : logic_.take_action_group_from_queue())
+		{
+			on_element_eliminate(action.source);
+		}
+	}
+}
+
+// 合并播放连续的填充和生成组
+// 先按顺序更新每个格子上的元素并累计移动步数，最后每个元素只做一次到最终位置的移动
+void CheckerboardLayer::run_merged_autofill()
+{
+	const int width = logic_.get_checkerboard_width();
+	fill_steps_.assign(elements_.size(), -1);
+	while (logic_.get_action_group_num() > 0)
+	{
+		const GameLogic::ActionType type = logic_.peek_action_group().front().type;
+		if (type != GameLogic::ActionType::AUTOFILL && type != GameLogic::ActionType::GENERATE)
+		{
+			break;
+		}
+
+		for (auto &action : logic_.take_action_group_from_queue())
+		{
+			const int source = action.source.y * width + action.source.x;
+			if (action.type == GameLogic::ActionType::GENERATE)
+			{
+				CCAssert(element_at(action.source) == nullptr, "");
+				on_refresh_checkerboard(action.source, action.element_type);
+				fill_steps_[source] = 0;
+			}
+			else
+			{
+				const int target = action.target.y * width + action.target.x;
+				CCAssert(elements_[source] != nullptr && elements_[target] == nullptr, "");
+				elements_[target] = elements_[source];
+				elements_[source] = nullptr;
+				fill_steps_[target] = std::max(fill_steps_[source], 0) + 1;
+				fill_steps_[source] = -1;
+			}
+		}
+	}
+
+	touch_lock_ = true;
+	handle_num_ = 1;
+	for (size_t idx = 0; idx < elements_.size(); ++idx)
+	{
+		if (fill_steps_[idx] >= 0 && elements_[idx] != nullptr)
+		{
+			++handle_num_;
+			const GameLogic::Vec2 pos(idx % width, idx / width);
+			elements_[idx]->auto_fill(scaled_duration(kAutofillDuration * fill_steps_[idx]), convert_to_world_pos(pos), [this]() { on_finish_action(); });
+		}
+	}
+
+	// 所有移动开始后再计数，避免提前开始下一波
+	on_finish_action();
+}
+
+// 跳过所有动作
+void CheckerboardLayer::skip_action_groups()
+{
+	while (logic_.get_action_group_num() > 0)
+	{
+		logic_.take_action_group_from_queue();
+	}
+
+	init_elements();
+	logic_.visit_checkerboard(std::bind(&CheckerboardLayer::on_refresh_checkerboard, this, std::placeholders::_1, std::placeholders::_2));
+	touch_lock_ = false;
+}
+
 // 刷新棋盘
 void CheckerboardLayer::on_refresh_checkerboard(const GameLogic::Vec2 &pos, int type)
 {
 	// 更新地板显示
 	{
-		size_t idx = pos.y * logic_.get_checkerboard_width() + pos.x;
-		while (idx >= floors_.size())
+		SpriteFrame *frame = nullptr;
+		if (type != GameLogic::FloorType::NOTHING)
 		{
-			auto element = Sprite::createWithSpriteFrameName("gs_el_floor.png");
-			element->setVisible(false);
-			batch_node_->addChild(element);
-			floors_.push_back(element);
+			frame = SpriteFrameCache::getInstance()->getSpriteFrameByName("gs_el_floor.png");
 		}
-
-		auto element = floors_[idx];
-		element->setPosition(convert_to_world_pos(pos));
-		element->setVisible(type != GameLogic::FloorType::NOTHING);
-		element->setLocalZOrder(0);
+		board_->set_floor(pos.y * logic_.get_checkerboard_width() + pos.x, convert_to_world_pos(pos), frame);
 	}
 
 	// 更新元素显示
@@ -182,16 +353,12 @@ void CheckerboardLayer::on_refresh_checkerboard(const GameLogic::Vec2 &pos, int
 		if (type > GameLogic::FloorType::NOELEMENT)
 		{
 			char buffer[128];
-			Sprite *element = nullptr;
 			sprintf(buffer, "gs_el_%02d.png", type);
 
-			auto itr = elements_.find(pos);
-			if (itr != elements_.end())
-			{
-				element = (*itr).second;
-			}
-			else
+			Element *&element = element_at(pos);
+			if (element == nullptr)
 			{
+				++element_num_;
 				if (!free_elements_.empty())
 				{
 					element = free_elements_.back();
@@ -201,13 +368,11 @@ void CheckerboardLayer::on_refresh_checkerboard(const GameLogic::Vec2 &pos, int
 				else
 				{
 					element = Element::createWithSpriteFrameName(buffer);
-					batch_node_->addChild(element);
+					board_->add_piece(element);
 				}
 			}
 			element->setVisible(true);
-			element->setLocalZOrder(1);
 			element->setPosition(convert_to_world_pos(pos));
-			elements_.insert(std::make_pair(pos, element));
 		}
 	}
 }
@@ -215,54 +380,46 @@ void CheckerboardLayer::on_refresh_checkerboard(const GameLogic::Vec2 &pos, int
 // 消除元素
 void CheckerboardLayer::on_element_eliminate(const GameLogic::Vec2 &pos)
 {
-	auto itr = elements_.find(pos);
-	CCAssert(itr != elements_.end(), "");
-	if (itr != elements_.end())
+	Element *&element = element_at(pos);
+	CCAssert(element != nullptr, "");
+	if (element != nullptr)
 	{
-		Element *element = dynamic_cast<Element *>(itr->second);
-		CCAssert(element != nullptr, "");
-		if (element != nullptr)
-		{
-			++handle_num_;
-			touch_lock_ = true;
-			elements_.erase(pos);
-			free_elements_.push_back(element);
-			element->eliminate(std::bind(&CheckerboardLayer::on_finish_action, this));
-		}
+		++handle_num_;
+		touch_lock_ = true;
+		--element_num_;
+		free_elements_.push_back(element);
+		element->eliminate([this]() { on_finish_action(); }, playback_speed_);
+		element = nullptr;
 	}
 }
 
 // 生成元素
 void CheckerboardLayer::on_element_generate(const GameLogic::Vec2 &pos, int type)
 {
-	auto itr = elements_.find(pos);
-	CCAssert(itr == elements_.end(), "");
-	if (itr == elements_.end())
+	CCAssert(element_at(pos) == nullptr, "");
+	if (element_at(pos) == nullptr)
 	{
 		++handle_num_;
 		touch_lock_ = true;
 		on_refresh_checkerboard(pos, type);
-		runAction(CallFunc::create(std::bind(&CheckerboardLayer::on_finish_action, this)));
+
+		// 没有动画，下一帧完成
+		element_at(pos)->move(0.0f, convert_to_world_pos(pos), [this]() { on_finish_action(); });
 	}
 }
 
 // 自动填充
 void CheckerboardLayer::on_element_autofill(const GameLogic::Vec2 &source, const GameLogic::Vec2 &target)
 {
-	auto itr = elements_.find(source);
-	CCAssert(itr != elements_.end(), "");
-	if (itr != elements_.end())
+	Element *element = element_at(source);
+	CCAssert(element != nullptr && element_at(target) == nullptr, "");
+	if (element != nullptr)
 	{
-		Element *element = dynamic_cast<Element *>(itr->second);
-		CCAssert(element != nullptr, "");
-		if (element != nullptr)
-		{
-			++handle_num_;
-			touch_lock_ = true;
-			elements_.erase(source);
-			elements_[target] = element;
-			element->auto_fill(0.1f, convert_to_world_pos(target), std::bind(&CheckerboardLayer::on_finish_action, this));
-		}
+		++handle_num_;
+		touch_lock_ = true;
+		element_at(source) = nullptr;
+		element_at(target) = element;
+		element->auto_fill(scaled_duration(kAutofillDuration), convert_to_world_pos(target), [this]() { on_finish_action(); });
 	}
 }
 
@@ -272,57 +429,73 @@ void CheckerboardLayer::on_finish_action()
 	assert(handle_num_ > 0);
 	if (--handle_num_ == 0)
 	{
-		// 下一波动作
+		// 下一波动作，播放中切换到跳过模式时直接显示剩余动作的结果
 		touch_lock_ = false;
-		run_action_group();
+		if (playback_mode_ == PlaybackMode::SKIP && logic_.get_action_group_num() > 0)
+		{
+			skip_action_groups();
+		}
+		else
+		{
+			run_action_group();
+		}
 	}
 }
 
 // 交换元素
 void CheckerboardLayer::swap_element(const GameLogic::Vec2 &a, const GameLogic::Vec2 &b)
 {
-	Element *current_element = dynamic_cast<Element *>((*elements_.find(a)).second);
-	Element *previous_element = dynamic_cast<Element *>((*elements_.find(b)).second);
+	Element *current_element = element_at(a);
+	Element *previous_element = element_at(b);
 	assert(current_element != nullptr && previous_element != nullptr);
 
-	elements_[a] = previous_element;
-	elements_[b] = current_element;
-	auto inside = [=]()->void
+	element_at(a) = previous_element;
+	element_at(b) = current_element;
+
+	// 回调只捕获this，不需要分配内存
+	swapping_[0] = a;
+	swapping_[1] = b;
+	swap_pending_ = 2;
+	auto inside = [this]()->void
 	{
-		static int count = 0;
-		if (++count == 2)
+		if (--swap_pending_ == 0)
 		{
-			count = 0;
-			swap_element_finished(a, b);
+			swap_element_finished(swapping_[0], swapping_[1]);
 		}
 	};
-	current_element->move(0.25f, previous_element->getPosition(), inside);
-	previous_element->move(0.25f, current_element->getPosition(), inside);
+	current_element->move(scaled_duration(kSwapDuration), previous_element->getPosition(), inside);
+	previous_element->move(scaled_duration(kSwapDuration), current_element->getPosition(), inside);
 }
 
 // 完成交换元素
 void CheckerboardLayer::swap_element_finished(const GameLogic::Vec2 &a, const GameLogic::Vec2 &b)
 {
-	if (!logic_.swap_and_eliminate(a, b))
+	const bool success = logic_.swap_and_eliminate(a, b);
+	replay_.set_result(logic_.get_score(), Replay::checkerboard_checksum(logic_.get_checkerboard()));
+	if (playback_mode_ == PlaybackMode::SKIP)
+	{
+		// 跳过模式不播放动作，失败时换回的两组移动也直接丢弃
+		skip_action_groups();
+	}
+	else if (!success)
 	{
-		Element *current_element = dynamic_cast<Element *>((*elements_.find(a)).second);
-		Element *previous_element = dynamic_cast<Element *>((*elements_.find(b)).second);
+		Element *current_element = element_at(a);
+		Element *previous_element = element_at(b);
 		assert(current_element != nullptr && previous_element != nullptr);
 
-		elements_[a] = previous_element;
-		elements_[b] = current_element;
+		element_at(a) = previous_element;
+		element_at(b) = current_element;
 
-		auto inside = [=]()->void
+		swap_pending_ = 2;
+		auto inside = [this]()->void
 		{
-			static int count = 0;
-			if (++count == 2)
+			if (--swap_pending_ == 0)
 			{
-				count = 0;
 				touch_lock_ = false;
 			}
 		};
-		current_element->move(0.25f, previous_element->getPosition(), inside);
-		previous_element->move(0.25f, current_element->getPosition(), inside);
+		current_element->move(scaled_duration(kSwapDuration), previous_element->getPosition(), inside);
+		previous_element->move(scaled_duration(kSwapDuration), current_element->getPosition(), inside);
 	}
 }
 
@@ -333,23 +506,20 @@ bool CheckerboardLayer::onTouchBegan(Touch *touch, Event *event)
 
 void CheckerboardLayer::onTouchMoved(Touch *touch, Event *event)
 {
-	if (touch_lock_ || elements_.empty())
+	if (touch_lock_ || element_num_ == 0)
 	{
 		return;
 	}
 
 	GameLogic::Vec2 current_selected = convert_to_checkerboard_pos(touch->getLocation());
-	auto itr = elements_.find(current_selected);
-	if (itr != elements_.end() && itr->second != nullptr)
+	if (current_selected != GameLogic::Vec2::invalid() && element_at(current_selected) != nullptr)
 	{
 		if (previous_selected_ != GameLogic::Vec2::invalid())
 		{
 			if (previous_selected_ != current_selected)
 			{
-				if (logic_.is_adjacent(current_selected, previous_selected_))
+				if (request_swap(current_selected, previous_selected_))
 				{
-					touch_lock_ = true;
-					swap_element(current_selected, previous_selected_);
 					previous_selected_ = GameLogic::Vec2::invalid();
 				}
 			}
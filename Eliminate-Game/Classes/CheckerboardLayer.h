@@ -1,14 +1,29 @@
 ﻿#pragma once
 
 #include "cocos2d.h"
+#include "Replay.h"
 #include "GameLogic.h"
 #include "CheckerboardCache.h"
 
+class Element;
+class BoardRenderer;
+
 class CheckerboardLayer : public cocos2d::Layer
 {
 	static const int kElementWidth = 74;
 	static const int kElementHeight = 73;
 
+public:
+	/**
+	 * 动作播放模式
+	 */
+	enum class PlaybackMode
+	{
+		NORMAL,			// 逐组播放
+		MERGED,			// 连续的消除组一起播放，连续的填充和生成组合并为一次移动
+		SKIP,			// 不播放动画，直接显示最终棋盘
+	};
+
 public:
 	CheckerboardLayer();
 
@@ -22,7 +37,34 @@ public:
 	/**
 	 * 开始游戏
 	 */
-	void start_game(const CheckerboardCache::Config &config);
+	void start_game(const CheckerboardCache::Config &config, unsigned int level);
+
+	/**
+	 * 设置播放模式
+	 */
+	void set_playback_mode(PlaybackMode mode);
+
+	/**
+	 * 设置播放速度倍数
+	 */
+	void set_playback_speed(float speed);
+
+	/**
+	 * 是否空闲
+	 * 没有正在播放或等待播放的动作，可以交换
+	 */
+	bool is_idle() const;
+
+	/**
+	 * 请求交换元素，供触摸和自动测试使用
+	 * @return 正在播放动作或不能交换返回false
+	 */
+	bool request_swap(const GameLogic::Vec2 &a, const GameLogic::Vec2 &b);
+
+	/**
+	 * 获取对局记录
+	 */
+	const Replay& get_replay() const;
 
 	/**
 	 * 获取起点坐标
@@ -55,6 +97,26 @@ private:
 	 */
 	void run_action_group();
 
+	/**
+	 * 合并播放连续的消除组
+	 */
+	void run_merged_eliminate();
+
+	/**
+	 * 合并播放连续的填充和生成组
+	 */
+	void run_merged_autofill();
+
+	/**
+	 * 跳过所有动作，显示最终棋盘
+	 */
+	void skip_action_groups();
+
+	/**
+	 * 按播放速度换算动作时长
+	 */
+	float scaled_duration(float duration) const;
+
 	/**
 	 * 消除元素
 	 */
@@ -82,14 +144,14 @@ private:
 
 private:
 	/**
-	 * 初始化地板
+	 * 初始化元素
 	 */
-	void init_floors();
+	void init_elements();
 
 	/**
-	 * 初始化元素
+	 * 获取格子上的元素
 	 */
-	void init_elements();
+	Element*& element_at(const GameLogic::Vec2 &pos);
 
 	/**
 	 * 交换元素
@@ -105,9 +167,15 @@ private:
 	bool										touch_lock_;
 	unsigned int								handle_num_;
 	GameLogic									logic_;
-	std::vector<cocos2d::Sprite*>				floors_;
-	std::map<GameLogic::Vec2, cocos2d::Sprite*>	elements_;
-	std::vector<cocos2d::Sprite *>				free_elements_;
-	cocos2d::SpriteBatchNode*					batch_node_;
+	Replay										replay_;
+	std::vector<Element*>						elements_;			// 按 y * width + x 索引，空格子为nullptr
+	unsigned int								element_num_;
+	std::vector<Element*>						free_elements_;
+	BoardRenderer*								board_;
 	GameLogic::Vec2								previous_selected_;
+	GameLogic::Vec2								swapping_[2];		// 正在交换的两个格子
+	unsigned int								swap_pending_;		// 交换中尚未结束的移动
+	PlaybackMode								playback_mode_;
+	float										playback_speed_;
+	std::vector<int>							fill_steps_;		// 合并填充时格子上的元素移动的步数，-1表示没有移动
 };
\ No newline at end of file
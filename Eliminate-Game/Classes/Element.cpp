@@ -1,6 +1,22 @@
 ﻿#include "Element.h"
 using namespace cocos2d;
 
+namespace
+{
+	// 消除动画：缩小，放大，淡出
+	const float kShrinkDuration = 0.4f;
+	const float kGrowDuration = 0.4f;
+	const float kFadeDuration = 0.1f;
+	const float kShrinkScale = 0.5f;
+}
+
+Element::Element()
+{
+	tween_.type = TweenType::NONE;
+	tween_.elapsed = 0;
+	tween_.duration = 0;
+	tween_.speed = 1.0f;
+}
 
 Element* Element::create()
 {
@@ -87,15 +103,25 @@ Element* Element::createWithSpriteFrameName(const std::string& spriteFrameName)
 	return createWithSpriteFrame(frame);
 }
 
+// 是否锁定
+bool Element::is_locked() const
+{
+	return tween_.type != TweenType::NONE;
+}
+
+// 移动
 void Element::move(float duration, const cocos2d::Vec2& position, const std::function<void()> &callback)
 {
 	CCAssert(callback != nullptr, "");
 	if (callback != nullptr)
 	{
-		runAction(Sequence::create(MoveTo::create(duration, position), CallFunc::create(callback), nullptr));
+		tween_.from = getPosition();
+		tween_.to = position;
+		start_tween(TweenType::MOVE, duration, 1.0f, callback);
 	}
 }
 
+// 自动填充
 void Element::auto_fill(float duration, const cocos2d::Vec2& position, const std::function<void()> &callback)
 {
 	CCAssert(callback != nullptr, "");
@@ -105,16 +131,92 @@ void Element::auto_fill(float duration, const cocos2d::Vec2& position, const std
 	}
 }
 
-void Element::eliminate(const std::function<void()> &callback)
+// 消除
+void Element::eliminate(const std::function<void()> &callback, float speed)
 {
-	CCAssert(callback != nullptr, "");
+	CCAssert(callback != nullptr && speed > 0, "");
 	if (callback != nullptr)
 	{
-		runAction(Sequence::create(EaseExponentialIn::create(ScaleTo::create(0.4f, 0.5f)),
-			EaseExponentialOut::create(ScaleTo::create(0.4f, 1.0f)),
-			FadeOut::create(0.1f),
-			CallFunc::create([=](){setOpacity(255); setScale(1.0f); setVisible(false); }),
-			CallFunc::create(callback),
-			nullptr));
+		start_tween(TweenType::ELIMINATE, kShrinkDuration + kGrowDuration + kFadeDuration, speed, callback);
+	}
+}
+
+// 进入场景
+// 更新只注册一次，空闲时直接返回，避免反复注册时分配调度项
+void Element::onEnter()
+{
+	Sprite::onEnter();
+	scheduleUpdate();
+}
+
+// 开始补间
+void Element::start_tween(TweenType type, float duration, float speed, const std::function<void()> &callback)
+{
+	CCAssert(tween_.type == TweenType::NONE, "element is animating");
+	tween_.type = type;
+	tween_.elapsed = 0;
+	tween_.duration = duration;
+	tween_.speed = speed;
+	tween_.callback = callback;
+}
+
+// 更新补间
+void Element::update(float delta)
+{
+	if (tween_.type == TweenType::NONE)
+	{
+		return;
+	}
+
+	tween_.elapsed = std::min(tween_.elapsed + delta * tween_.speed, tween_.duration);
+	const bool finished = tween_.elapsed >= tween_.duration;
+	switch (tween_.type)
+	{
+		case TweenType::MOVE:
+		{
+			const float percent = tween_.duration > 0 ? tween_.elapsed / tween_.duration : 1.0f;
+			setPosition(tween_.from + (tween_.to - tween_.from) * percent);
+			break;
+		}
+		case TweenType::ELIMINATE:
+		{
+			apply_eliminate(tween_.elapsed);
+			if (finished)
+			{
+				setOpacity(255);
+				setScale(1.0f);
+				setVisible(false);
+			}
+			break;
+		}
+		default:
+			break;
+	}
+
+	// 回调中可能开始新的补间，先清空状态
+	if (finished)
+	{
+		std::function<void()> callback;
+		callback.swap(tween_.callback);
+		tween_.type = TweenType::NONE;
+		callback();
+	}
+}
+
+// 应用消除动画
+void Element::apply_eliminate(float elapsed)
+{
+	if (elapsed < kShrinkDuration)
+	{
+		setScale(1.0f + (kShrinkScale - 1.0f) * tweenfunc::expoEaseIn(elapsed / kShrinkDuration));
+	}
+	else if (elapsed < kShrinkDuration + kGrowDuration)
+	{
+		setScale(kShrinkScale + (1.0f - kShrinkScale) * tweenfunc::expoEaseOut((elapsed - kShrinkDuration) / kGrowDuration));
+	}
+	else
+	{
+		setScale(1.0f);
+		setOpacity(static_cast<GLubyte>(255 * (1.0f - (elapsed - kShrinkDuration - kGrowDuration) / kFadeDuration)));
 	}
 }
\ No newline at end of file
@@ -3,8 +3,34 @@
 
 #include "cocos2d.h"
 
+/**
+ * 棋盘元素
+ * 动画由内置的补间完成，不创建动作对象
+ * 回调只捕获少量数据时(如一个指针)保存在std::function内部，播放动画不分配内存
+ */
 class Element final : public cocos2d::Sprite
 {
+	enum class TweenType
+	{
+		NONE,
+		MOVE,
+		ELIMINATE,
+	};
+
+	/**
+	 * 补间状态
+	 */
+	struct Tween
+	{
+		TweenType				type;
+		float					elapsed;
+		float					duration;
+		float					speed;			// 播放速度倍数
+		cocos2d::Vec2			from;
+		cocos2d::Vec2			to;
+		std::function<void()>	callback;
+	};
+
 public:
 	static Element* create();
 	static Element* create(const std::string& filename);
@@ -32,12 +58,31 @@ public:
 
 	/**
 	 * 消除
+	 * @param speed 播放速度倍数
 	 */
-	void eliminate(const std::function<void()> &callback);
+	void eliminate(const std::function<void()> &callback, float speed = 1.0f);
+
+public:
+	virtual void onEnter() override;
+
+	virtual void update(float delta) override;
 
 private:
-	Element() = default;
+	Element();
 	~Element() = default;
+
+	/**
+	 * 开始补间
+	 */
+	void start_tween(TweenType type, float duration, float speed, const std::function<void()> &callback);
+
+	/**
+	 * 应用消除动画
+	 */
+	void apply_eliminate(float elapsed);
+
+private:
+	Tween	tween_;
 };
 
 #endif
\ No newline at end of file
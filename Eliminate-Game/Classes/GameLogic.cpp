@@ -1,12 +1,21 @@
 ﻿#include "GameLogic.h"
 
-#include <ctime>
 #include <limits>
 #include <cassert>
+#include <cstdlib>
+#include <algorithm>
+
+// 类型按位保存在uint32_t中
+static const int kMaxTypeNum = 31;
+
+// 生成棋盘时每个位置最多排除两种类型，至少需要三种类型才能保证没有三消
+static const int kMinTypeNum = 3;
 
 
 GameLogic::GameLogic()
-	: generator_(time(nullptr))
+	: top_line_(-1)
+	, seed_(0)
+	, score_(0)
 {
 
 }
@@ -17,31 +26,47 @@ GameLogic::~GameLogic()
 }
 
 // 开始游戏
-void GameLogic::start_game(const CheckerboardCache::Config &config)
+void GameLogic::start_game(const CheckerboardConfig &config, uint64_t seed)
 {
-	assert(config.type_num > 1);
+	assert(config.type_num >= kMinTypeNum && config.type_num <= kMaxTypeNum);
 	assert(config.width > 0 && config.height > 0);
 	assert(config.width * config.height == config.layout.size());
+	assert(config.width <= Bitboard::kMaxSize && config.height <= Bitboard::kMaxSize);
 
 	config_ = config;
+	seed_ = seed;
+	score_ = 0;
+	random_.seed(seed);
+	action_group_queue_.clear();
 	size_t max_size = config_.width * config_.height;
-	std::uniform_int_distribution<int> dis(1, config.type_num);
+	checkerboard_.assign(max_size, FloorType::NOTHING);
+	bitboard_.reset(config_.width, config_.height, config_.type_num);
+	match_mask_.assign(config_.height, 0);
+	eliminate_mask_.assign(config_.height, 0);
+	empty_mask_.assign(config_.height, 0);
+	dirty_mask_.assign(config_.height, 0);
+	moved_mask_.assign(config_.height, 0);
+	filled_mask_.assign(config_.height, 0);
+	pending_mask_.assign(config_.height, 0);
+	next_pending_mask_.assign(config_.height, 0);
+
+	// 生成初始棋盘
+	Bitboard::Line cells[Bitboard::kMaxSize] = { 0 };
 	for (size_t idx = 0; idx < max_size; ++idx)
 	{
 		if (config.layout[idx] != 0)
 		{
-			checkerboard_.push_back(dis(generator_));
-		}
-		else
-		{
-			checkerboard_.push_back(FloorType::NOTHING);
+			cells[idx / config_.width] |= Bitboard::Line(1) << (idx % config_.width);
 		}
 	}
-
-	init_search_scope();
-	std::vector<Action> action_group;
-	add_action_to_group(ActionType::START, FloorType::NOTHING, Vec2::invalid(), Vec2::invalid(), action_group);
-	add_action_group(std::move(action_group));
+	generate_elements(cells, nullptr);
+
+	top_line_ = get_top_line();
+	init_distance_to_top();
+	init_fed_mask();
+	begin_action_group();
+	add_action_to_group(ActionType::START, FloorType::NOTHING, Vec2::invalid(), Vec2::invalid());
+	end_action_group();
 }
 
 // 获取棋盘宽度
@@ -56,23 +81,34 @@ int GameLogic::get_checkerboard_height() const
 	return config_.height;
 }
 
+// 获取随机种子
+uint64_t GameLogic::get_seed() const
+{
+	return seed_;
+}
+
+// 获取得分
+int GameLogic::get_score() const
+{
+	return score_;
+}
+
 // 获取动作组数量
 size_t GameLogic::get_action_group_num() const
 {
-	return action_group_queue_.size();
+	return action_group_queue_.group_num();
 }
 
 // 取出动作组信息
-std::vector<GameLogic::Action> GameLogic::take_action_group_from_queue()
+GameLogic::ActionGroup GameLogic::take_action_group_from_queue()
 {
-	assert(!action_group_queue_.empty());
-	std::vector<GameLogic::Action> ret;
-	if (!action_group_queue_.empty())
-	{
-		ret = std::move(action_group_queue_.front());
-		action_group_queue_.pop();
-	}
-	return ret;
+	return action_group_queue_.take_group();
+}
+
+// 查看队首的动作组
+GameLogic::ActionGroup GameLogic::peek_action_group() const
+{
+	return action_group_queue_.front_group();
 }
 
 // 添加动作更新回调
@@ -84,28 +120,35 @@ void GameLogic::add_action_update_callback(std::function<void()> &&callback)
 	}
 }
 
-// 添加动作组
-void GameLogic::add_action_group(std::vector<Action> &&action_group)
+// 开始添加动作组
+void GameLogic::begin_action_group()
 {
-	if (!action_group.empty())
-	{
-		action_group_queue_.push(action_group);
-		for (auto &func : action_callback_list_)
-		{
-			func();
-		}
-	}
+	action_group_queue_.begin_group();
 }
 
 // 添加动作到组
-void GameLogic::add_action_to_group(ActionType type, int element_type, const Vec2 &source, const Vec2 &target, std::vector<Action> &ret_action_group)
+void GameLogic::add_action_to_group(ActionType type, int element_type, const Vec2 &source, const Vec2 &target)
 {
 	Action action;
 	action.type = type;
 	action.source = source;
 	action.target = target;
 	action.element_type = element_type;
-	ret_action_group.push_back(action);
+	action_group_queue_.push(action);
+}
+
+// 结束添加动作组
+size_t GameLogic::end_action_group()
+{
+	const size_t num = action_group_queue_.end_group();
+	if (num > 0)
+	{
+		for (auto &func : action_callback_list_)
+		{
+			func();
+		}
+	}
+	return num;
 }
 
 // 获取棋盘数据
@@ -154,164 +197,311 @@ bool GameLogic::is_adjacent(const Vec2 &a, const Vec2 &b) const
 {
 	if (is_in_checkerboard(a) && is_in_checkerboard(b))
 	{
-		return abs(a.y + a.x - b.y - b.x) == 1;
+		return abs(a.x - b.x) + abs(a.y - b.y) == 1;
 	}
 	return false;
 }
 
-// 初始化搜索范围
-void GameLogic::init_search_scope()
+// 放置元素
+void GameLogic::set_element(int idx, int type)
 {
-	scope_.min_col = scope_.min_row = std::numeric_limits<int>::max();
-	scope_.max_col = scope_.max_row = std::numeric_limits<int>::min();
+	const int x = idx % config_.width;
+	const int y = idx / config_.width;
+	if (checkerboard_[idx] > FloorType::NOELEMENT)
+	{
+		bitboard_.clear(x, y, checkerboard_[idx]);
+	}
+	checkerboard_[idx] = type;
+	if (type > FloorType::NOELEMENT)
+	{
+		bitboard_.set(x, y, type);
+	}
+
+	if (type == FloorType::NOELEMENT)
+	{
+		empty_mask_[y] |= Bitboard::Line(1) << x;
+	}
+	else
+	{
+		empty_mask_[y] &= ~(Bitboard::Line(1) << x);
+	}
+}
+
+// 交换元素
+void GameLogic::swap_element(int a, int b)
+{
+	const int type_a = checkerboard_[a];
+	const int type_b = checkerboard_[b];
+	set_element(a, type_b);
+	set_element(b, type_a);
+}
+
+// 清除状态改变标记
+void GameLogic::clear_dirty()
+{
+	std::fill(dirty_mask_.begin(), dirty_mask_.end(), 0);
 }
 
-// 更新搜索范围
-void GameLogic::update_search_scope(const Vec2 &pos)
+// 标记状态改变的位置
+void GameLogic::mark_dirty(const Vec2 &pos)
 {
-	if (pos.x >= 0 && pos.x < config_.width)
+	if (pos.x < 0 || pos.x >= config_.width || pos.y < 0 || pos.y >= config_.height)
 	{
-		if (pos.x <= scope_.min_col)
-		{
-			scope_.min_col = pos.x > 0 ? pos.x - 1 : pos.x;
-		}
+		assert(false);
+		return;
+	}
 
-		if (pos.x >= scope_.max_col)
-		{
-			scope_.max_col = pos.x + 1 < config_.width ? pos.x + 1 : pos.x;
-		}
+	const int min_col = std::max(pos.x - 1, 0);
+	const int max_col = std::min(pos.x + 1, config_.width - 1);
+	const Bitboard::Line bits = Bitboard::range_mask(min_col, max_col - min_col + 1);
+	const int min_row = std::max(pos.y - 1, 0);
+	const int max_row = std::min(pos.y + 1, config_.height - 1);
+	for (int row = min_row; row <= max_row; ++row)
+	{
+		dirty_mask_[row] |= bits;
 	}
-	else
+}
+
+// 初始化到顶行的距离
+void GameLogic::init_distance_to_top()
+{
+	const int max_size = config_.width * config_.height;
+	distance_to_top_.assign(max_size, std::numeric_limits<int>::max());
+
+	const int top_line = top_line_;
+	if (top_line < 0)
 	{
-		assert(false);
+		return;
 	}
 
-	if (pos.y >= 0 && pos.y < config_.height)
+	// 顶行作为起点
+	std::vector<int> open_list;
+	open_list.reserve(max_size);
+	for (int col = 0; col < config_.width; ++col)
 	{
-		if (pos.y <= scope_.min_row)
+		const int idx = top_line * config_.width + col;
+		if (config_.layout[idx] != 0)
 		{
-			scope_.min_row = pos.y > 0 ? pos.y - 1 : pos.y;
+			distance_to_top_[idx] = 0;
+			open_list.push_back(idx);
 		}
+	}
 
-		if (pos.y >= scope_.max_row)
+	// 逐层扩展
+	static const int kOffsets[4][2] = { { 0, -1 }, { -1, 0 }, { 1, 0 }, { 0, 1 } };
+	for (size_t head = 0; head < open_list.size(); ++head)
+	{
+		const int idx = open_list[head];
+		const Vec2 pos(idx % config_.width, idx / config_.width);
+		for (auto &offset : kOffsets)
 		{
-			scope_.max_row = pos.y + 1 < config_.height ? pos.y + 1 : pos.y;
+			const int next = vec2_to_index(Vec2(pos.x + offset[0], pos.y + offset[1]));
+			if (next >= 0 && config_.layout[next] != 0 && distance_to_top_[next] == std::numeric_limits<int>::max())
+			{
+				distance_to_top_[next] = distance_to_top_[idx] + 1;
+				open_list.push_back(next);
+			}
 		}
 	}
-	else
+}
+
+// 求最短距离
+int GameLogic::shortest_distance_to_top(const Vec2 &pos) const
+{
+	const int idx = vec2_to_index(pos);
+	return idx >= 0 ? distance_to_top_[idx] : std::numeric_limits<int>::max();
+}
+
+// 放置后会形成三消的类型
+uint32_t GameLogic::get_forbidden_types(const Vec2 &pos) const
+{
+	uint32_t types = 0;
+	for (int type = 1; type <= config_.type_num; ++type)
 	{
-		assert(false);
+		if (bitboard_.would_match(pos.x, pos.y, type))
+		{
+			types |= 1u << type;
+		}
 	}
+	return types;
 }
 
-// 求最短距离
-int GameLogic::shortest_distance_to_top(const Vec2 &pos)
+// 放置后相邻元素与之交换即可形成三消的类型
+// 该位置当前为空，相邻元素处的连线自然不会计入它，与交换后该位置变为其他类型的结果一致
+uint32_t GameLogic::get_move_types(const Vec2 &pos) const
 {
-	std::vector<int> heap;
-	for (int col = 0; col < config_.width; ++col)
+	static const int kOffsets[4][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+
+	uint32_t types = 0;
+	for (auto &offset : kOffsets)
 	{
-		if (config_.layout[col] != 0)
+		const Vec2 neighbor(pos.x + offset[0], pos.y + offset[1]);
+		if (!is_valid_element(neighbor))
 		{
-			AStar::Param param;
-			param.start.x = col;
-			param.start.y = config_.height - 1;
-			param.end.x = pos.x;
-			param.end.y = pos.y;
-			param.width = config_.width;
-			param.height = config_.height;
-			param.is_canreach = [&](const AStar::Vec2 &point)
-			{
-				return config_.layout[point.y * config_.width + point.x] != 0;
-			};
+			continue;
+		}
 
-			size_t distance = a_star_.search(param).size();
-			if (distance > 0)
+		const int neighbor_type = checkerboard_[vec2_to_index(neighbor)];
+		for (int type = 1; type <= config_.type_num; ++type)
+		{
+			if (type != neighbor_type && bitboard_.would_match(neighbor.x, neighbor.y, type))
 			{
-				heap.push_back(distance);
-				std::push_heap(heap.begin(), heap.end(), [](int a, int b)->bool
-				{
-					return a > b;
-				});
+				types |= 1u << type;
 			}
 		}
 	}
-	return heap.size() > 0 ? heap[0] : std::numeric_limits<int>::max();
+	return types;
 }
 
-// 是否可消除
-std::set<GameLogic::Vec2> GameLogic::can_eliminate(const Vec2 &pos) const
+// 从多个类型中随机选取一个
+int GameLogic::choose_type(uint32_t types, const int *pool)
 {
-	std::set<Vec2> vertical;
-	std::set<Vec2> horizontal;
-	std::set<Vec2> eliminate_set;
-	if (!is_valid_element(pos))
+	assert(types != 0);
+	if (pool == nullptr)
 	{
-		return eliminate_set;
+		int nth = random_.next_int(0, Bitboard::bit_count(types) - 1);
+		while (nth-- > 0)
+		{
+			types &= types - 1;
+		}
+		return Bitboard::lowest_bit(types);
 	}
-	const int type = checkerboard_[vec2_to_index(pos)];
 
-	// 纵向遍历
+	// 按剩余数量加权，数量多的类型先用掉，减少末尾只剩下会形成三消的类型
+	int total = 0;
+	for (uint32_t bits = types; bits != 0; bits &= bits - 1)
 	{
-		for (int row = 0; row < config_.height; ++row)
+		total += pool[Bitboard::lowest_bit(bits)];
+	}
+	int nth = random_.next_int(0, total - 1);
+	for (uint32_t bits = types; bits != 0; bits &= bits - 1)
+	{
+		const int type = Bitboard::lowest_bit(bits);
+		nth -= pool[type];
+		if (nth < 0)
 		{
-			const int idx = row * config_.width + pos.x;
-			if (checkerboard_[idx] == type)
+			return type;
+		}
+	}
+	return Bitboard::highest_bit(types);
+}
+
+// 填充元素
+// 按行扫描一遍，每个位置只从放置后不会形成三消的类型中选取，
+// 与左侧、下方已放置的元素相比，每个位置最多排除两种类型，三种及以上类型时总有可选的类型
+// 剩余数量的类型都被排除时改用其他类型，重排后的类型数量因此可能略有变化
+// 在还没有可交换位置时，优先选取能与相邻元素形成可交换位置的类型，不需要整盘拒绝重来
+bool GameLogic::fill_elements(const Bitboard::Line *cells, int *pool)
+{
+	const uint32_t all_types = ((1u << config_.type_num) - 1) << 1;
+	bool has_move = false;
+	for (int row = 0; row < config_.height; ++row)
+	{
+		for (Bitboard::Line line = cells[row]; line != 0; line &= line - 1)
+		{
+			const Vec2 pos(Bitboard::lowest_bit(line), row);
+
+			uint32_t types = all_types;
+			if (pool != nullptr)
+			{
+				types = 0;
+				for (int type = 1; type <= config_.type_num; ++type)
+				{
+					types |= pool[type] > 0 ? 1u << type : 0;
+				}
+			}
+
+			const uint32_t forbidden = get_forbidden_types(pos);
+			uint32_t allowed = types & ~forbidden;
+			bool from_pool = pool != nullptr;
+			if (allowed == 0)
 			{
-				vertical.insert(Vec2(pos.x, row));
+				allowed = all_types & ~forbidden;
+				from_pool = false;
 			}
-			else
+			assert(allowed != 0);
+
+			if (!has_move)
 			{
-				// 满足消除条件
-				if (vertical.size() >= 3 && (vertical.find(pos) != vertical.end()))
+				const uint32_t wanted = allowed & get_move_types(pos);
+				if (wanted != 0)
 				{
-					break;
+					allowed = wanted;
+					has_move = true;
 				}
-				vertical.clear();
 			}
+
+			const int type = choose_type(allowed, from_pool ? pool : nullptr);
+			if (from_pool)
+			{
+				--pool[type];
+			}
+			set_element(vec2_to_index(pos), type);
 		}
 	}
+	return has_move || bitboard_.has_move();
+}
 
-	// 横向遍历
+// 制造可交换位置
+bool GameLogic::plant_move()
+{
+	const uint32_t all_types = ((1u << config_.type_num) - 1) << 1;
+	for (int idx = 0; idx < static_cast<int>(checkerboard_.size()); ++idx)
 	{
-		for (int col = 0; col < config_.width; ++col)
+		const int type = checkerboard_[idx];
+		if (type <= FloorType::NOELEMENT)
 		{
-			const int idx = pos.y * config_.width + col;
-			if (checkerboard_[idx] == type)
-			{
-				horizontal.insert(Vec2(col, pos.y));
-			}
-			else
+			continue;
+		}
+
+		set_element(idx, FloorType::NOELEMENT);
+		const Vec2 pos(idx % config_.width, idx / config_.width);
+		const uint32_t allowed = all_types & ~get_forbidden_types(pos) & ~(1u << type);
+		for (uint32_t bits = allowed; bits != 0; bits &= bits - 1)
+		{
+			set_element(idx, Bitboard::lowest_bit(bits));
+			if (bitboard_.has_move())
 			{
-				// 满足消除条件
-				if (horizontal.size() >= 3 && (horizontal.find(pos) != horizontal.end()))
-				{
-					break;
-				}
-				horizontal.clear();
+				return true;
 			}
 		}
+		set_element(idx, type);
 	}
+	return false;
+}
 
-	// 插入数据
-	if (vertical.size() < 3 || vertical.find(pos) == vertical.end())
+// 生成元素
+// 填充一遍即没有三消，只在没有可交换位置时修改一个元素
+void GameLogic::generate_elements(const Bitboard::Line *cells, const int *pool)
+{
+	for (int row = 0; row < config_.height; ++row)
 	{
-		vertical.clear();
+		for (Bitboard::Line line = cells[row]; line != 0; line &= line - 1)
+		{
+			set_element(row * config_.width + Bitboard::lowest_bit(line), FloorType::NOELEMENT);
+		}
 	}
-	else
+
+	int counts[kMaxTypeNum + 1] = { 0 };
+	if (pool != nullptr)
 	{
-		eliminate_set.insert(vertical.begin(), vertical.end());
+		std::copy(pool, pool + kMaxTypeNum + 1, counts);
 	}
 
-	if (horizontal.size() < 3 || horizontal.find(pos) == horizontal.end())
+	if (!fill_elements(cells, pool != nullptr ? counts : nullptr))
 	{
-		horizontal.clear();
+		plant_move();
 	}
-	else
+}
+
+// 是否可消除
+bool GameLogic::can_eliminate(const Vec2 &pos, std::vector<Bitboard::Line> &ret) const
+{
+	if (!is_valid_element(pos))
 	{
-		eliminate_set.insert(horizontal.begin(), horizontal.end());
+		return false;
 	}
-
-	return eliminate_set;
+	return bitboard_.find_match_at(pos.x, pos.y, checkerboard_[vec2_to_index(pos)], &ret[0]);
 }
 
 // 获取顶行
@@ -321,7 +511,7 @@ int GameLogic::get_top_line() const
 	{
 		for (int col = 0; col < config_.width; ++col)
 		{
-			int idx = row * config_.height + col;
+			int idx = row * config_.width + col;
 			if (config_.layout[idx] != 0)
 			{
 				return row;
@@ -331,218 +521,440 @@ int GameLogic::get_top_line() const
 	return -1;
 }
 
+// 初始化可补充区域
+void GameLogic::init_fed_mask()
+{
+	fed_mask_.assign(config_.height, 0);
+	if (top_line_ < 0)
+	{
+		return;
+	}
+
+	// 顶行作为起点
+	std::vector<Vec2> open_list;
+	open_list.reserve(config_.width * config_.height);
+	for (int col = 0; col < config_.width; ++col)
+	{
+		if (config_.layout[top_line_ * config_.width + col] != 0)
+		{
+			fed_mask_[top_line_] |= Bitboard::Line(1) << col;
+			open_list.push_back(Vec2(col, top_line_));
+		}
+	}
+
+	// 沿下落与横移规则扩展
+	auto expand = [&](const Vec2 &pos)
+	{
+		if (is_in_checkerboard(pos) && config_.layout[vec2_to_index(pos)] != 0 && !is_fed(pos))
+		{
+			fed_mask_[pos.y] |= Bitboard::Line(1) << pos.x;
+			open_list.push_back(pos);
+		}
+	};
+
+	for (size_t head = 0; head < open_list.size(); ++head)
+	{
+		const Vec2 pos = open_list[head];
+		expand(Vec2(pos.x, pos.y - 1));
+		if (pos.y < top_line_)
+		{
+			if (pos.x - 1 >= 0 && config_.layout[vec2_to_index(Vec2(pos.x - 1, pos.y + 1))] == 0)
+			{
+				expand(Vec2(pos.x - 1, pos.y));
+			}
+			if (pos.x + 1 < config_.width && config_.layout[vec2_to_index(Vec2(pos.x + 1, pos.y + 1))] == 0)
+			{
+				expand(Vec2(pos.x + 1, pos.y));
+			}
+		}
+	}
+}
+
+// 是否可补充
+bool GameLogic::is_fed(const Vec2 &pos) const
+{
+	return (fed_mask_[pos.y] & (Bitboard::Line(1) << pos.x)) != 0;
+}
+
+// 是否已被填充
+bool GameLogic::is_moved(const Vec2 &pos) const
+{
+	return (moved_mask_[pos.y] & (Bitboard::Line(1) << pos.x)) != 0;
+}
+
 // 生成顶行元素
-std::set<GameLogic::Vec2> GameLogic::generate_element_to_top_line()
+int GameLogic::generate_element_to_top_line()
 {
 	int num = 0;
-	int row = 0;
-	std::set<Vec2> ret;
-	const size_t max_size = config_.width * config_.height;
-	std::uniform_int_distribution<int> dis(1, config_.type_num);
-	if ((row = get_top_line()) > 0)
+	const int row = top_line_;
+	if (row > 0)
 	{
-		std::vector<Action> action_group;
+		begin_action_group();
 		for (int col = 0; col < config_.width; ++col)
 		{
-			int idx = row * config_.height + col;
+			int idx = row * config_.width + col;
 			if (checkerboard_[idx] == FloorType::NOELEMENT)
 			{
-				ret.insert(Vec2(col, row));
-				int type = dis(generator_);
-				checkerboard_[idx] = type;
-				add_action_to_group(ActionType::GENERATE, type, Vec2(col, row), Vec2::invalid(), action_group);
+				filled_mask_[row] |= Bitboard::Line(1) << col;
+				mark_dirty(Vec2(col, row));
+				int type = random_.next_int(1, config_.type_num);
+				set_element(idx, type);
+				add_action_to_group(ActionType::GENERATE, type, Vec2(col, row), Vec2::invalid());
 			}
 		}
-		if (!action_group.empty())
+		num = end_action_group();
+	}
+	return num;
+}
+
+// 标记待检查位置
+// pos的状态改变后，它自己、上方一格与左右两格的移动结果可能改变
+// 位于扫描位置之后的在本轮检查，之前的留到下一轮
+void GameLogic::mark_autofill_pending(const Vec2 &cursor, const Vec2 &pos)
+{
+	auto mark = [&](int row, Bitboard::Line bits)
+	{
+		if (row >= config_.height)
 		{
-			num = action_group.size();
-			add_action_group(std::move(action_group));
+			return;
 		}
-	}
-	return ret;
+
+		bits &= dirty_mask_[row];
+		Bitboard::Line later = 0;
+		if (row > cursor.y)
+		{
+			later = ~Bitboard::Line(0);
+		}
+		else if (row == cursor.y)
+		{
+			later = ~Bitboard::range_mask(0, cursor.x + 1);
+		}
+		pending_mask_[row] |= bits & later;
+		next_pending_mask_[row] |= bits & ~later;
+	};
+
+	const int min_col = std::max(pos.x - 2, 0);
+	const int max_col = std::min(pos.x + 2, config_.width - 1);
+	mark(pos.y, Bitboard::range_mask(min_col, max_col - min_col + 1));
+	mark(pos.y + 1, Bitboard::Line(1) << pos.x);
 }
 
-// 自动填充
-std::set<GameLogic::Vec2> GameLogic::autofill_element()
+// 填充移动
+void GameLogic::autofill_move(const Vec2 &cursor, const Vec2 &source, const Vec2 &target)
 {
-	// 生成元素
-	std::set<Vec2> ret = generate_element_to_top_line();
+	const int source_idx = vec2_to_index(source);
+	const int target_idx = vec2_to_index(target);
+	add_action_to_group(ActionType::AUTOFILL, checkerboard_[source_idx], source, target);
+	swap_element(source_idx, target_idx);
+
+	moved_mask_[target.y] |= Bitboard::Line(1) << target.x;
+	filled_mask_[target.y] |= Bitboard::Line(1) << target.x;
+
+	mark_dirty(source);
+	mark_dirty(target);
+	mark_autofill_pending(cursor, source);
+	mark_autofill_pending(cursor, target);
+}
 
-	// 填充空位
-	std::set<Vec2> moved_set;
-	size_t last_move_set_size = 0;
-	std::vector<Action> action_group;
-	const int top_line = get_top_line();
-	do
+// 检查单个位置的填充
+bool GameLogic::autofill_at(const Vec2 &pos)
+{
+	const int col = pos.x;
+	const int row = pos.y;
+	if (checkerboard_[vec2_to_index(pos)] <= FloorType::NOELEMENT || is_moved(pos))
 	{
-		last_move_set_size = moved_set.size();
-		for (int row = scope_.min_row; row <= scope_.max_row; ++row)
+		return false;
+	}
+
+	// 向下移动
+	if (row - 1 >= 0 &&
+		checkerboard_[vec2_to_index(Vec2(col, row - 1))] == FloorType::NOELEMENT)
+	{
+		autofill_move(pos, pos, Vec2(col, row - 1));
+		return true;
+	}
+
+	// 横向移动，只移向顶行可以补充到的位置
+	if (top_line_ > row)
+	{
+		// 左移
+		if (col - 1 >= 0 &&
+			config_.layout[vec2_to_index(Vec2(col - 1, row + 1))] == 0 &&
+			checkerboard_[vec2_to_index(Vec2(col - 1, row))] == FloorType::NOELEMENT &&
+			is_fed(Vec2(col - 1, row)))
+		{
+			if (col - 2 >= 0 && config_.layout[vec2_to_index(Vec2(col - 2, row + 1))] != 0)
+			{
+				if (shortest_distance_to_top(Vec2(col, row)) <= shortest_distance_to_top(Vec2(col - 2, row)))
+				{
+					autofill_move(pos, pos, Vec2(col - 1, row));
+					return true;
+				}
+				else if (checkerboard_[vec2_to_index(Vec2(col - 2, row))] > FloorType::NOELEMENT &&
+						 !is_moved(Vec2(col - 2, row)))
+				{
+					autofill_move(pos, Vec2(col - 2, row), Vec2(col - 1, row));
+					return true;
+				}
+			}
+			else
+			{
+				autofill_move(pos, pos, Vec2(col - 1, row));
+				return true;
+			}
+		}
+
+		// 右移
+		if (col + 1 < config_.width &&
+			config_.layout[vec2_to_index(Vec2(col + 1, row + 1))] == 0 &&
+			checkerboard_[vec2_to_index(Vec2(col + 1, row))] == FloorType::NOELEMENT &&
+			is_fed(Vec2(col + 1, row)))
 		{
-			for (int col = scope_.min_col; col <= scope_.max_col; ++col)
+			if (col + 2 < config_.width && config_.layout[vec2_to_index(Vec2(col + 2, row + 1))] != 0)
 			{
-				const int idx = vec2_to_index(Vec2(col, row));
-				if (checkerboard_[idx] > FloorType::NOELEMENT && moved_set.find(Vec2(col, row)) == moved_set.end())
+				if (shortest_distance_to_top(Vec2(col, row)) <= shortest_distance_to_top(Vec2(col + 2, row)))
 				{
-					// 向下移动
-					if (row - 1 >= 0 &&
-						checkerboard_[vec2_to_index(Vec2(col, row - 1))] == FloorType::NOELEMENT)
-					{
-						moved_set.insert(Vec2(col, row - 1));
-						add_action_to_group(ActionType::AUTOFILL, checkerboard_[idx], Vec2(col, row), Vec2(col, row - 1), action_group);
-						std::swap(checkerboard_[idx], checkerboard_[vec2_to_index(Vec2(col, row - 1))]);
-						continue;
-					}
-					// 横向移动
-					else if (top_line > row)
-					{
-						// 左移
-						if (col - 1 >= 0 &&
-							config_.layout[vec2_to_index(Vec2(col - 1, row + 1))] == 0 &&
-							checkerboard_[vec2_to_index(Vec2(col - 1, row))] == FloorType::NOELEMENT)
-						{
-							if (col - 2 >= 0 && config_.layout[vec2_to_index(Vec2(col - 2, row + 1))] != 0)
-							{
-								if (shortest_distance_to_top(Vec2(col, row)) <= shortest_distance_to_top(Vec2(col - 2, row)))
-								{
-									moved_set.insert(Vec2(col - 1, row));
-									add_action_to_group(ActionType::AUTOFILL, checkerboard_[idx], Vec2(col, row), Vec2(col - 1, row), action_group);
-									std::swap(checkerboard_[idx], checkerboard_[vec2_to_index(Vec2(col - 1, row))]);
-									continue;
-								}
-								else if (checkerboard_[vec2_to_index(Vec2(col - 2, row))] > FloorType::NOELEMENT &&
-										 moved_set.find(Vec2(col - 2, row)) == moved_set.end())
-								{
-									moved_set.insert(Vec2(col - 1, row));
-									add_action_to_group(ActionType::AUTOFILL, checkerboard_[vec2_to_index(Vec2(col - 2, row))], Vec2(col - 2, row), Vec2(col - 1, row), action_group);
-									std::swap(checkerboard_[vec2_to_index(Vec2(col - 2, row))], checkerboard_[vec2_to_index(Vec2(col - 1, row))]);
-									continue;
-								}
-							}
-							else
-							{
-								moved_set.insert(Vec2(col - 1, row));
-								add_action_to_group(ActionType::AUTOFILL, checkerboard_[idx], Vec2(col, row), Vec2(col - 1, row), action_group);
-								std::swap(checkerboard_[idx], checkerboard_[vec2_to_index(Vec2(col - 1, row))]);
-								continue;
-							}
-						}
-
-						// 右移
-						if (col + 1 < config_.width &&
-							config_.layout[vec2_to_index(Vec2(col + 1, row + 1))] == 0 &&
-							checkerboard_[vec2_to_index(Vec2(col + 1, row))] == FloorType::NOELEMENT)
-						{
-							if (col + 2 < config_.width && config_.layout[vec2_to_index(Vec2(col + 2, row + 1))] != 0)
-							{
-								if (shortest_distance_to_top(Vec2(col, row)) <= shortest_distance_to_top(Vec2(col + 2, row)))
-								{
-									moved_set.insert(Vec2(col + 1, row));
-									add_action_to_group(ActionType::AUTOFILL, checkerboard_[idx], Vec2(col, row), Vec2(col + 1, row), action_group);
-									std::swap(checkerboard_[idx], checkerboard_[vec2_to_index(Vec2(col + 1, row))]);
-									continue;
-								}
-								else if (checkerboard_[vec2_to_index(Vec2(col + 2, row))] > FloorType::NOELEMENT &&
-										 moved_set.find(Vec2(col + 2, row)) == moved_set.end())
-								{
-									moved_set.insert(Vec2(col + 1, row));
-									add_action_to_group(ActionType::AUTOFILL, checkerboard_[vec2_to_index(Vec2(col + 2, row))], Vec2(col + 2, row), Vec2(col + 1, row), action_group);
-									std::swap(checkerboard_[vec2_to_index(Vec2(col + 2, row))], checkerboard_[vec2_to_index(Vec2(col + 1, row))]);
-									continue;
-								}
-							}
-							else
-							{
-								moved_set.insert(Vec2(col + 1, row));
-								add_action_to_group(ActionType::AUTOFILL, checkerboard_[idx], Vec2(col, row), Vec2(col + 1, row), action_group);
-								std::swap(checkerboard_[idx], checkerboard_[vec2_to_index(Vec2(col + 1, row))]);
-								continue;
-							}
-						}
-					}
+					autofill_move(pos, pos, Vec2(col + 1, row));
+					return true;
 				}
+				else if (checkerboard_[vec2_to_index(Vec2(col + 2, row))] > FloorType::NOELEMENT &&
+						 !is_moved(Vec2(col + 2, row)))
+				{
+					autofill_move(pos, Vec2(col + 2, row), Vec2(col + 1, row));
+					return true;
+				}
+			}
+			else
+			{
+				autofill_move(pos, pos, Vec2(col + 1, row));
+				return true;
 			}
 		}
+	}
 
-	} while (moved_set.size() > last_move_set_size);
+	return false;
+}
 
-	// 记录被补充的位置
-	ret.insert(moved_set.begin(), moved_set.end());
+// 自动填充
+// 每个元素每次最多移动一格，按行扫描直到没有元素移动
+// 只有上方或左右存在空位的格子才可能移动，因此首轮只检查改变区域内空位周围的格子，
+// 之后只检查状态发生改变的格子周围，开销与移动的元素数量成正比
+int GameLogic::autofill_element()
+{
+	// 生成元素
+	int ret = generate_element_to_top_line();
 
-	// 更新搜索范围
-	for (auto &item : action_group)
+	// 首轮检查空位上方与左右两侧的格子
+	Bitboard::Line any = 0;
+	std::fill(moved_mask_.begin(), moved_mask_.end(), 0);
+	std::fill(next_pending_mask_.begin(), next_pending_mask_.end(), 0);
+	for (int row = 0; row < config_.height; ++row)
 	{
-		update_search_scope(item.source);
+		Bitboard::Line pending = (empty_mask_[row] << 1) | (empty_mask_[row] >> 1);
+		if (row > 0)
+		{
+			pending |= empty_mask_[row - 1];
+		}
+		pending_mask_[row] = pending & dirty_mask_[row];
+		any |= pending_mask_[row];
+	}
+	if (any == 0)
+	{
+		return ret;
 	}
 
-	// 添加动作组
-	if (!action_group.empty())
+	// 填充空位
+	bool moved = true;
+	begin_action_group();
+	while (moved)
 	{
-		add_action_group(std::move(action_group));
+		moved = false;
+		for (int row = 0; row < config_.height; ++row)
+		{
+			while (pending_mask_[row] != 0)
+			{
+				const int col = Bitboard::lowest_bit(pending_mask_[row]);
+				pending_mask_[row] &= pending_mask_[row] - 1;
+				moved = autofill_at(Vec2(col, row)) || moved;
+			}
+		}
+		pending_mask_.swap(next_pending_mask_);
 	}
 
+	// 添加动作组
+	ret += end_action_group();
+
 	return ret;
 }
 
 // 消除元素
-void GameLogic::eliminate(const std::set<Vec2> &eliminate_set)
+void GameLogic::eliminate(const std::vector<Bitboard::Line> &eliminate_mask)
 {
-	std::vector<Action> action_group;
-	for (auto &pos : eliminate_set)
+	begin_action_group();
+	for (int row = 0; row < config_.height; ++row)
 	{
-		if (is_valid_element(pos))
-		{
-			update_search_scope(pos);
-			add_action_to_group(ActionType::REMOVE, checkerboard_[vec2_to_index(pos)], pos, Vec2::invalid(), action_group);
-			checkerboard_[vec2_to_index(pos)] = FloorType::NOELEMENT;
-		}
-		else
+		Bitboard::Line line = eliminate_mask[row];
+		while (line != 0)
 		{
-			assert(false);
+			const Vec2 pos(Bitboard::lowest_bit(line), row);
+			line &= line - 1;
+			if (is_valid_element(pos))
+			{
+				mark_dirty(pos);
+				add_action_to_group(ActionType::REMOVE, checkerboard_[vec2_to_index(pos)], pos, Vec2::invalid());
+				++score_;
+				set_element(vec2_to_index(pos), FloorType::NOELEMENT);
+			}
+			else
+			{
+				assert(false);
+			}
 		}
 	}
-	add_action_group(std::move(action_group));
+	end_action_group();
 }
 
 // 执行消除
-void GameLogic::run_eliminate(const std::set<Vec2> &eliminate_set)
+void GameLogic::run_eliminate(std::vector<Bitboard::Line> &eliminate_mask)
 {
 	// 消除元素
-	eliminate(eliminate_set);
+	clear_dirty();
+	eliminate(eliminate_mask);
 
 	// 循环填充，直到无法消除
-	std::set<Vec2> all_moved_set;
-	std::set<Vec2> new_eliminate_set;
+	std::fill(filled_mask_.begin(), filled_mask_.end(), 0);
 	while (true)
 	{
 		// 填充所有空位
-		std::set<Vec2> moved_set;
-		do
+		while (autofill_element() > 0)
 		{
-			moved_set = autofill_element();
-			all_moved_set.insert(moved_set.begin(), moved_set.end());
-		} while (!moved_set.empty());
-
-		// 初始化搜索范围
-		init_search_scope();
+		}
 
 		// 检查填充后是否可消除
-		for (auto &pos : all_moved_set)
+		// 只检测本轮填充到的格子，其中可消除的位置才需要求出所在的连线
+		bool found = false;
+		std::fill(eliminate_mask.begin(), eliminate_mask.end(), 0);
+		if (bitboard_.find_matches_in(&filled_mask_[0], &match_mask_[0]))
 		{
-			auto ret = can_eliminate(pos);
-			new_eliminate_set.insert(ret.begin(), ret.end());
+			for (int row = 0; row < config_.height; ++row)
+			{
+				Bitboard::Line line = match_mask_[row];
+				while (line != 0)
+				{
+					const int col = Bitboard::lowest_bit(line);
+					line &= line - 1;
+					found = can_eliminate(Vec2(col, row), eliminate_mask) || found;
+				}
+			}
 		}
-		all_moved_set.clear();
+		std::fill(filled_mask_.begin(), filled_mask_.end(), 0);
+		clear_dirty();
 
 		// 无法消除
-		if (new_eliminate_set.empty())
+		if (!found)
 		{
 			break;
 		}
 
 		// 消除元素
-		eliminate(new_eliminate_set);
-		new_eliminate_set.clear();
+		eliminate(eliminate_mask);
+	}
+}
+
+// 查找所有可以形成消除的交换
+size_t GameLogic::find_legal_moves(std::vector<MoveTrack> &ret) const
+{
+	ret.clear();
+	Bitboard::Line horizontal[Bitboard::kMaxSize];
+	Bitboard::Line vertical[Bitboard::kMaxSize];
+	if (!bitboard_.find_moves(horizontal, vertical))
+	{
+		return 0;
+	}
+
+	MoveTrack move;
+	for (int row = 0; row < config_.height; ++row)
+	{
+		for (Bitboard::Line line = horizontal[row]; line != 0; line &= line - 1)
+		{
+			move.source = Vec2(Bitboard::lowest_bit(line), row);
+			move.target = Vec2(move.source.x + 1, row);
+			ret.push_back(move);
+		}
+		for (Bitboard::Line line = vertical[row]; line != 0; line &= line - 1)
+		{
+			move.source = Vec2(Bitboard::lowest_bit(line), row);
+			move.target = Vec2(move.source.x, row + 1);
+			ret.push_back(move);
+		}
+	}
+	return ret.size();
+}
+
+// 是否存在可以形成消除的交换
+bool GameLogic::has_legal_move() const
+{
+	return bitboard_.has_move();
+}
+
+// 获取提示
+bool GameLogic::get_hint(MoveTrack &ret) const
+{
+	Bitboard::Line horizontal[Bitboard::kMaxSize];
+	Bitboard::Line vertical[Bitboard::kMaxSize];
+	if (!bitboard_.find_moves(horizontal, vertical))
+	{
+		return false;
+	}
+
+	for (int row = 0; row < config_.height; ++row)
+	{
+		if (horizontal[row] != 0)
+		{
+			ret.source = Vec2(Bitboard::lowest_bit(horizontal[row]), row);
+			ret.target = Vec2(ret.source.x + 1, row);
+			return true;
+		}
+		if (vertical[row] != 0)
+		{
+			ret.source = Vec2(Bitboard::lowest_bit(vertical[row]), row);
+			ret.target = Vec2(ret.source.x, row + 1);
+			return true;
+		}
+	}
+	return false;
+}
+
+// 重排棋盘
+bool GameLogic::reshuffle()
+{
+	int pool[kMaxTypeNum + 1] = { 0 };
+	Bitboard::Line cells[Bitboard::kMaxSize] = { 0 };
+	bool empty = true;
+	for (int row = 0; row < config_.height; ++row)
+	{
+		for (int col = 0; col < config_.width; ++col)
+		{
+			const int type = checkerboard_[row * config_.width + col];
+			if (type > FloorType::NOELEMENT)
+			{
+				++pool[type];
+				cells[row] |= Bitboard::Line(1) << col;
+				empty = false;
+			}
+		}
 	}
+	if (empty)
+	{
+		return false;
+	}
+
+	generate_elements(cells, pool);
+
+	begin_action_group();
+	add_action_to_group(ActionType::RESHUFFLE, FloorType::NOTHING, Vec2::invalid(), Vec2::invalid());
+	end_action_group();
+	return true;
 }
 
 // 交换位置并消除
@@ -555,42 +967,40 @@ bool GameLogic::swap_and_eliminate(const Vec2 &a, const Vec2 &b)
 	}
 
 	// 交换元素
-	std::swap(checkerboard_[vec2_to_index(a)], checkerboard_[vec2_to_index(b)]);
+	swap_element(vec2_to_index(a), vec2_to_index(b));
 	{
-		std::vector<Action> action_group;
-		add_action_to_group(ActionType::MOVE, checkerboard_[vec2_to_index(b)], a, b, action_group);
-		add_action_to_group(ActionType::MOVE, checkerboard_[vec2_to_index(a)], b, a, action_group);
-		add_action_group(std::move(action_group));
+		begin_action_group();
+		add_action_to_group(ActionType::MOVE, checkerboard_[vec2_to_index(b)], a, b);
+		add_action_to_group(ActionType::MOVE, checkerboard_[vec2_to_index(a)], b, a);
+		end_action_group();
 	}
 
 	// 检测是否可消除
-	std::set<Vec2> eliminate_set;
-	{
-		std::set<Vec2> temp = can_eliminate(a);
-		eliminate_set.insert(temp.begin(), temp.end());
-		temp = can_eliminate(b);
-		eliminate_set.insert(temp.begin(), temp.end());
-	}
+	std::fill(eliminate_mask_.begin(), eliminate_mask_.end(), 0);
+	bool found = can_eliminate(a, eliminate_mask_);
+	found = can_eliminate(b, eliminate_mask_) || found;
 
-	if (eliminate_set.empty())
+	if (!found)
 	{
 		// 交换失败，恢复原状
-		std::swap(checkerboard_[vec2_to_index(a)], checkerboard_[vec2_to_index(b)]);
+		swap_element(vec2_to_index(a), vec2_to_index(b));
 		{
-			std::vector<Action> action_group;
-			add_action_to_group(ActionType::MOVE, checkerboard_[vec2_to_index(b)], a, b, action_group);
-			add_action_to_group(ActionType::MOVE, checkerboard_[vec2_to_index(a)], b, a, action_group);
-			add_action_group(std::move(action_group));
+			begin_action_group();
+			add_action_to_group(ActionType::MOVE, checkerboard_[vec2_to_index(b)], a, b);
+			add_action_to_group(ActionType::MOVE, checkerboard_[vec2_to_index(a)], b, a);
+			end_action_group();
 		}
 		return false;
 	}
-	else
-	{
-		assert(eliminate_set.size() >= 3);
-	}
 
 	// 消除元素
-	run_eliminate(eliminate_set);
+	run_eliminate(eliminate_mask_);
+
+	// 没有可交换位置时重排
+	if (!has_legal_move())
+	{
+		reshuffle();
+	}
 
 	return true;
 }
\ No newline at end of file
@@ -1,12 +1,12 @@
 ﻿#ifndef __GAMELOGIC_H__
 #define __GAMELOGIC_H__
 
-#include <queue>
 #include <vector>
-#include <random>
 #include <functional>
-#include "AStar/AStar.h"
-#include "CheckerboardCache.h"
+#include "Random.h"
+#include "Bitboard.h"
+#include "GroupQueue.h"
+#include "CheckerboardConfig.h"
 
 class GameLogic
 {
@@ -31,6 +31,7 @@ public:
 		REMOVE,				// 消除
 		GENERATE,			// 生成
 		AUTOFILL,			// 自动填充
+		RESHUFFLE,			// 重排，整个棋盘需要刷新
 	};
 
 	/**
@@ -65,17 +66,6 @@ public:
 		}
 	};
 
-	/**
-	 * 搜索范围
-	 */
-	struct SearchScope
-	{
-		int min_row;
-		int min_col;
-		int max_row;
-		int max_col;
-	};
-
 	/**
 	 * 移动路径
 	 */
@@ -101,6 +91,12 @@ public:
 		Vec2			target;						// 目标位置
 	};
 
+	/**
+	 * 动作组
+	 * 指向动作队列内部，在下一次产生动作的调用之前有效
+	 */
+	typedef GroupQueue<Action>::Span ActionGroup;
+
 public:
 	GameLogic();
 
@@ -108,8 +104,22 @@ public:
 
 	/**
 	 * 开始游戏
+	 * 相同的配置与种子生成相同的棋盘和动作序列
+	 * 初始棋盘没有可消除的元素，且至少存在一个可交换位置
+	 * 类型数量至少为3，两种类型时无法保证初始棋盘没有三消
+	 */
+	void start_game(const CheckerboardConfig &config, uint64_t seed);
+
+	/**
+	 * 获取随机种子
 	 */
-	void start_game(const CheckerboardCache::Config &config);
+	uint64_t get_seed() const;
+
+	/**
+	 * 获取得分
+	 * 累计消除的元素数量
+	 */
+	int get_score() const;
 
 	/**
 	 * 获取棋盘宽度
@@ -128,8 +138,15 @@ public:
 
 	/**
 	 * 取出动作组信息
+	 * 返回的动作组在下一次开始游戏或交换之前有效
+	 */
+	ActionGroup take_action_group_from_queue();
+
+	/**
+	 * 查看队首的动作组，不取出
+	 * 返回的动作组在下一次取出、开始游戏或交换之前有效
 	 */
-	std::vector<Action> take_action_group_from_queue();
+	ActionGroup peek_action_group() const;
 
 	/**
 	 * 添加动作更新回调
@@ -172,75 +189,210 @@ public:
 	 */
 	bool swap_and_eliminate(const Vec2 &a, const Vec2 &b);
 
+	/**
+	 * 查找所有可以形成消除的交换
+	 * 不修改棋盘也不产生动作，source为左侧或下方的位置
+	 * @return 交换数量
+	 */
+	size_t find_legal_moves(std::vector<MoveTrack> &ret) const;
+
+	/**
+	 * 是否存在可以形成消除的交换
+	 */
+	bool has_legal_move() const;
+
+	/**
+	 * 获取提示
+	 * @return 不存在可以形成消除的交换返回false
+	 */
+	bool get_hint(MoveTrack &ret) const;
+
+	/**
+	 * 重排棋盘
+	 * 打乱现有元素的位置，重排后没有可消除的元素且至少存在一个可交换位置
+	 * 只产生一个RESHUFFLE动作，而不是每个位置一个动作
+	 * @return 棋盘上没有元素返回false
+	 */
+	bool reshuffle();
+
 protected:
 	GameLogic(const GameLogic&) = delete;
 	GameLogic& operator= (const GameLogic&) = delete;
 
 private:
 	/**
-	 * 初始化搜索范围
+	 * 清除状态改变标记
 	 */
-	void init_search_scope();
+	void clear_dirty();
 
 	/**
-	 * 更新搜索范围
+	 * 标记状态改变的位置
+	 * 该位置及周围一圈的格子在本轮连消中需要检查
 	 */
-	void update_search_scope(const Vec2 &pos);
+	void mark_dirty(const Vec2 &pos);
+
+	/**
+	 * 初始化到顶行的距离
+	 * 以顶行所有格子为起点做广度优先搜索，棋盘布局不变，开始游戏时计算一次即可
+	 */
+	void init_distance_to_top();
 
 	/**
 	 * 求最短距离
 	 */
-	int shortest_distance_to_top(const Vec2 &pos);
+	int shortest_distance_to_top(const Vec2 &pos) const;
+
+	/**
+	 * 放置元素
+	 */
+	void set_element(int idx, int type);
+
+	/**
+	 * 交换元素
+	 */
+	void swap_element(int a, int b);
+
+	/**
+	 * 放置后会形成三消的类型
+	 * @return 按位表示类型
+	 */
+	uint32_t get_forbidden_types(const Vec2 &pos) const;
+
+	/**
+	 * 放置后相邻元素与之交换即可形成三消的类型
+	 * @return 按位表示类型
+	 */
+	uint32_t get_move_types(const Vec2 &pos) const;
+
+	/**
+	 * 从多个类型中随机选取一个
+	 * @param pool 每种类型剩余的数量，不为空时按数量加权
+	 */
+	int choose_type(uint32_t types, const int *pool);
+
+	/**
+	 * 填充元素
+	 * @param cells 按行表示需要填充的空位
+	 * @param pool 每种类型剩余的数量，为空时不限数量
+	 * @return 存在可交换位置返回true，填充后总是没有可消除的元素
+	 */
+	bool fill_elements(const Bitboard::Line *cells, int *pool);
+
+	/**
+	 * 制造可交换位置
+	 * 修改一个元素的类型，不形成三消
+	 * @return 找不到可以修改的元素返回false
+	 */
+	bool plant_move();
+
+	/**
+	 * 生成元素
+	 * 按给定的类型数量填充一遍，没有可交换位置时修改一个元素
+	 * @param cells 按行表示需要生成元素的位置，原有元素会被清除
+	 * @param pool 每种类型的数量，为空时不限数量
+	 */
+	void generate_elements(const Bitboard::Line *cells, const int *pool);
 
 	/**
 	 * 是否可消除
+	 * @param ret 按行写入可消除的位置
 	 */
-	std::set<Vec2> can_eliminate(const Vec2 &pos) const;
+	bool can_eliminate(const Vec2 &pos, std::vector<Bitboard::Line> &ret) const;
 
 	/**
 	 * 获取顶行
 	 */
 	int get_top_line() const;
 
+	/**
+	 * 初始化可补充区域
+	 * 从顶行出发，按下落与横移规则能够到达的位置
+	 */
+	void init_fed_mask();
+
+	/**
+	 * 是否可补充
+	 */
+	bool is_fed(const Vec2 &pos) const;
+
+	/**
+	 * 是否已被填充
+	 */
+	bool is_moved(const Vec2 &pos) const;
+
 	/**
 	 * 生成顶行元素
 	 * @return 生成数量
 	 */
-	std::set<Vec2> generate_element_to_top_line();
+	int generate_element_to_top_line();
+
+	/**
+	 * 标记待检查位置
+	 */
+	void mark_autofill_pending(const Vec2 &cursor, const Vec2 &pos);
+
+	/**
+	 * 填充移动
+	 */
+	void autofill_move(const Vec2 &cursor, const Vec2 &source, const Vec2 &target);
+
+	/**
+	 * 检查单个位置的填充
+	 * @return 是否发生移动
+	 */
+	bool autofill_at(const Vec2 &pos);
 
 	/**
 	 * 自动填充
-	 * @return 填充数量
+	 * @return 生成与填充数量
 	 */
-	std::set<Vec2> autofill_element();
+	int autofill_element();
 
 	/**
 	 * 消除元素
 	 */
-	void eliminate(const std::set<Vec2> &eliminate_set);
+	void eliminate(const std::vector<Bitboard::Line> &eliminate_mask);
 
 	/**
 	 * 执行消除
 	 */
-	void run_eliminate(const std::set<Vec2> &eliminate_set);
+	void run_eliminate(std::vector<Bitboard::Line> &eliminate_mask);
 
 	/**
-	 * 添加动作组
+	 * 开始添加动作组
 	 */
-	void add_action_group(std::vector<Action> &&action_group);
+	void begin_action_group();
 
 	/**
 	 * 添加动作到组
 	 */
-	void add_action_to_group(ActionType type, int element_type, const Vec2 &source, const Vec2 &target, std::vector<Action> &ret_action_group);
+	void add_action_to_group(ActionType type, int element_type, const Vec2 &source, const Vec2 &target);
+
+	/**
+	 * 结束添加动作组，空组不会入队
+	 * @return 组内动作数量
+	 */
+	size_t end_action_group();
 
 private:
-	AStar									a_star_;
-	SearchScope								scope_;
-	CheckerboardCache::Config				config_;
-	std::default_random_engine				generator_;
+	int										top_line_;
+	Bitboard								bitboard_;
+	CheckerboardConfig						config_;
+	uint64_t								seed_;
+	int										score_;
+	Random									random_;
 	std::vector<int>						checkerboard_;
-	std::queue< std::vector<Action> >		action_group_queue_;
+	std::vector<int>						distance_to_top_;
+	std::vector<Bitboard::Line>				match_mask_;
+	std::vector<Bitboard::Line>				eliminate_mask_;
+	std::vector<Bitboard::Line>				empty_mask_;			// 空位
+	std::vector<Bitboard::Line>				dirty_mask_;			// 本轮连消中状态改变的位置及其周围
+	std::vector<Bitboard::Line>				fed_mask_;				// 顶行可以补充到的位置
+	std::vector<Bitboard::Line>				moved_mask_;			// 本次填充中被填入的位置
+	std::vector<Bitboard::Line>				filled_mask_;			// 本轮连消中被生成或填入的位置
+	std::vector<Bitboard::Line>				pending_mask_;			// 本轮待检查的位置
+	std::vector<Bitboard::Line>				next_pending_mask_;		// 下一轮待检查的位置
+	GroupQueue<Action>						action_group_queue_;
 	std::vector< std::function<void()> >	action_callback_list_;
 };
 
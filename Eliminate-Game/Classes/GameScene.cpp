@@ -1,8 +1,27 @@
 ﻿#include "GameScene.h"
 #include "VisibleRect.h"
+#include "StaticBatch.h"
 #include "CheckerboardLayer.h"
 using namespace cocos2d;
 
+namespace
+{
+	// 开始关卡，关卡包中没有关卡时解析TMX文件
+	void start_level(CheckerboardLayer *checkerboard, CheckerboardCache::ConfigPtr config)
+	{
+		if (config == nullptr)
+		{
+			auto cache = CheckerboardCache::instance();
+			cache->add_checkerboard_config("map/01.tmx");
+			config = cache->get_checkerboard_config("map/01.tmx");
+		}
+
+		if (config != nullptr)
+		{
+			checkerboard->start_game(*config, 1);
+		}
+	}
+}
 
 Scene* GameScene::createScene()
 {
@@ -19,20 +38,34 @@ bool GameScene::init()
         return false;
     }
 
+	// 背景不会变化，只在第一帧收集一次
+	auto background_batch = StaticBatch::create();
+	addChild(background_batch);
+
 	auto background = Sprite::create("background.png");
 	background->setPosition(VisibleRect::center());
-	addChild(background);
+	background_batch->addChild(background);
 
 	SpriteFrameCache::getInstance()->addSpriteFramesWithFile("img/elements.plist");
 
 	auto checkerboard = CheckerboardLayer::create();
 	addChild(checkerboard);
 
-	CheckerboardCache::Config config;
-	CheckerboardCache::instance()->add_checkerboard_config("map/01.tmx");
-	if (CheckerboardCache::instance()->get_checkerboard_config("map/01.tmx", config))
+	// 优先使用打包好的关卡，在后台解码，不阻塞场景的第一帧
+	auto cache = CheckerboardCache::instance();
+	if (cache->load_level_archive("map/levels.bin"))
+	{
+		// 回调前场景可能已经退出，持有棋盘直到回调结束
+		checkerboard->retain();
+		cache->load_checkerboard_config_async(1, [checkerboard](const CheckerboardCache::ConfigPtr &config)
+		{
+			start_level(checkerboard, config);
+			checkerboard->release();
+		});
+	}
+	else
 	{
-		checkerboard->start_game(config);
+		start_level(checkerboard, nullptr);
 	}
 
 	return true;
@@ -0,0 +1,298 @@
+﻿/**
+ * 分组环形队列
+ * 元素连续存放在预分配的环形缓冲区中，按组写入、按组取出，稳定运行时不再分配内存
+ */
+
+#ifndef __GROUPQUEUE_H__
+#define __GROUPQUEUE_H__
+
+#include <vector>
+#include <cassert>
+#include <cstddef>
+
+template <typename T>
+class GroupQueue
+{
+public:
+	/**
+	 * 组视图
+	 * 指向缓冲区内的连续元素，在队列下一次写入或取出之前有效
+	 */
+	class Span
+	{
+	public:
+		Span()
+			: data_(nullptr)
+			, size_(0)
+		{
+		}
+
+		Span(const T *data, size_t size)
+			: data_(data)
+			, size_(size)
+		{
+		}
+
+		const T* begin() const { return data_; }
+		const T* end() const { return data_ + size_; }
+		const T& front() const { assert(size_ > 0); return data_[0]; }
+		const T& back() const { assert(size_ > 0); return data_[size_ - 1]; }
+		const T& operator[] (size_t idx) const { assert(idx < size_); return data_[idx]; }
+		size_t size() const { return size_; }
+		bool empty() const { return size_ == 0; }
+
+	private:
+		const T*	data_;
+		size_t		size_;
+	};
+
+public:
+	explicit GroupQueue(size_t capacity = 1024, size_t group_capacity = 64)
+		: items_(capacity > 0 ? capacity : 1)
+		, groups_(group_capacity > 0 ? group_capacity : 1)
+	{
+		clear();
+	}
+
+	/**
+	 * 清空
+	 */
+	void clear()
+	{
+		head_ = 0;
+		tail_ = 0;
+		wrapped_ = false;
+		group_head_ = 0;
+		group_count_ = 0;
+		open_ = false;
+		open_begin_ = 0;
+		open_size_ = 0;
+	}
+
+	/**
+	 * 已提交的组数量
+	 */
+	size_t group_num() const
+	{
+		return group_count_;
+	}
+
+	/**
+	 * 开始写入新组
+	 */
+	void begin_group()
+	{
+		assert(!open_);
+		open_ = true;
+		open_begin_ = tail_;
+		open_size_ = 0;
+	}
+
+	/**
+	 * 写入元素到当前组
+	 */
+	void push(const T &item)
+	{
+		assert(open_);
+		reserve_one();
+		items_[tail_++] = item;
+		++open_size_;
+	}
+
+	/**
+	 * 当前正在写入的组
+	 */
+	Span current_group() const
+	{
+		return Span(open_size_ > 0 ? &items_[open_begin_] : nullptr, open_size_);
+	}
+
+	/**
+	 * 结束写入，空组直接丢弃
+	 * @return 组内元素数量
+	 */
+	size_t end_group()
+	{
+		assert(open_);
+		open_ = false;
+		if (open_size_ == 0)
+		{
+			return 0;
+		}
+
+		if (group_count_ == groups_.size())
+		{
+			grow_groups();
+		}
+		Group &group = groups_[(group_head_ + group_count_) % groups_.size()];
+		group.begin = open_begin_;
+		group.size = open_size_;
+		++group_count_;
+
+		const size_t size = open_size_;
+		open_size_ = 0;
+		open_begin_ = tail_;
+		return size;
+	}
+
+	/**
+	 * 查看最早提交的组，不取出
+	 * 返回的视图在下一次写入或取出之前有效
+	 */
+	Span front_group() const
+	{
+		assert(group_count_ > 0);
+		if (group_count_ == 0)
+		{
+			return Span();
+		}
+
+		const Group &group = groups_[group_head_];
+		return Span(&items_[group.begin], group.size);
+	}
+
+	/**
+	 * 取出最早提交的组
+	 * 返回的视图在下一次写入或取出之前有效
+	 */
+	Span take_group()
+	{
+		assert(group_count_ > 0);
+		if (group_count_ == 0)
+		{
+			return Span();
+		}
+
+		const Group group = groups_[group_head_];
+		group_head_ = (group_head_ + 1) % groups_.size();
+		--group_count_;
+
+		// 释放该组占用的空间
+		if (group_count_ > 0)
+		{
+			const size_t next = groups_[group_head_].begin;
+			if (next < head_)
+			{
+				wrapped_ = false;
+			}
+			head_ = next;
+		}
+		else if (open_ && open_size_ > 0)
+		{
+			if (open_begin_ < head_)
+			{
+				wrapped_ = false;
+			}
+			head_ = open_begin_;
+		}
+		else
+		{
+			// 队列已空，回到缓冲区起点
+			head_ = 0;
+			tail_ = 0;
+			open_begin_ = 0;
+			wrapped_ = false;
+		}
+
+		return Span(&items_[group.begin], group.size);
+	}
+
+private:
+	struct Group
+	{
+		size_t begin;
+		size_t size;
+	};
+
+	// 保证当前组后面还有一个连续的空位
+	void reserve_one()
+	{
+		if (!wrapped_)
+		{
+			if (tail_ < items_.size())
+			{
+				return;
+			}
+
+			// 到达末尾，把当前组搬到缓冲区起点
+			const bool empty = group_count_ == 0;
+			const size_t limit = empty ? open_begin_ : head_;
+			if (open_size_ + 1 <= limit)
+			{
+				for (size_t i = 0; i < open_size_; ++i)
+				{
+					items_[i] = items_[open_begin_ + i];
+				}
+				if (empty)
+				{
+					head_ = 0;
+				}
+				else
+				{
+					wrapped_ = true;
+				}
+				open_begin_ = 0;
+				tail_ = open_size_;
+				return;
+			}
+		}
+		else if (tail_ < head_)
+		{
+			return;
+		}
+
+		grow_items();
+	}
+
+	// 扩容并按顺序重新排列
+	void grow_items()
+	{
+		std::vector<T> items(items_.size() * 2);
+		size_t offset = 0;
+		for (size_t i = 0; i < group_count_; ++i)
+		{
+			Group &group = groups_[(group_head_ + i) % groups_.size()];
+			for (size_t j = 0; j < group.size; ++j)
+			{
+				items[offset + j] = items_[group.begin + j];
+			}
+			group.begin = offset;
+			offset += group.size;
+		}
+		for (size_t j = 0; j < open_size_; ++j)
+		{
+			items[offset + j] = items_[open_begin_ + j];
+		}
+
+		items_.swap(items);
+		head_ = 0;
+		open_begin_ = offset;
+		tail_ = offset + open_size_;
+		wrapped_ = false;
+	}
+
+	void grow_groups()
+	{
+		std::vector<Group> groups(groups_.size() * 2);
+		for (size_t i = 0; i < group_count_; ++i)
+		{
+			groups[i] = groups_[(group_head_ + i) % groups_.size()];
+		}
+		groups_.swap(groups);
+		group_head_ = 0;
+	}
+
+private:
+	std::vector<T>		items_;
+	std::vector<Group>	groups_;
+	size_t				head_;			// 最早的组起点
+	size_t				tail_;			// 下一个写入位置
+	bool				wrapped_;		// 数据是否跨越缓冲区末尾
+	size_t				group_head_;
+	size_t				group_count_;
+	bool				open_;
+	size_t				open_begin_;
+	size_t				open_size_;
+};
+
+#endif
@@ -0,0 +1,318 @@
+﻿#include "LevelArchive.h"
+
+#include <cstring>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+	template <typename T>
+	void write_value(std::vector<uint8_t> &out, T value)
+	{
+		for (size_t i = 0; i < sizeof(T); ++i)
+		{
+			out.push_back(static_cast<uint8_t>(value >> (i * 8)));
+		}
+	}
+
+	template <typename T>
+	T read_value(const uint8_t *data)
+	{
+		T value = 0;
+		for (size_t i = 0; i < sizeof(T); ++i)
+		{
+			value |= static_cast<T>(data[i]) << (i * 8);
+		}
+		return value;
+	}
+
+	// 映射只读文件
+	void* map_file(const std::string &filename, size_t &size)
+	{
+#if defined(_WIN32)
+		HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return nullptr;
+		}
+
+		LARGE_INTEGER file_size;
+		void *ret = nullptr;
+		if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0)
+		{
+			HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mapping != nullptr)
+			{
+				ret = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+				size = static_cast<size_t>(file_size.QuadPart);
+				CloseHandle(mapping);
+			}
+		}
+		CloseHandle(file);
+		return ret;
+#else
+		const int fd = ::open(filename.c_str(), O_RDONLY);
+		if (fd < 0)
+		{
+			return nullptr;
+		}
+
+		struct stat info;
+		void *ret = nullptr;
+		if (fstat(fd, &info) == 0 && info.st_size > 0)
+		{
+			ret = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			if (ret == MAP_FAILED)
+			{
+				ret = nullptr;
+			}
+			size = static_cast<size_t>(info.st_size);
+		}
+		::close(fd);
+		return ret;
+#endif
+	}
+
+	void unmap_file(void *data, size_t size)
+	{
+#if defined(_WIN32)
+		(void)size;
+		UnmapViewOfFile(data);
+#else
+		munmap(data, size);
+#endif
+	}
+}
+
+
+// 转换为棋盘配置
+void LevelArchive::Level::to_config(CheckerboardConfig &ret) const
+{
+	ret.width = width;
+	ret.height = height;
+	ret.type_num = type_num;
+	ret.layout.resize(width * height);
+	for (int row = 0; row < height; ++row)
+	{
+		for (int col = 0; col < width; ++col)
+		{
+			ret.layout[row * width + col] = is_floor(col, row);
+		}
+	}
+}
+
+LevelArchive::LevelArchive()
+	: data_(nullptr)
+	, size_(0)
+	, level_num_(0)
+	, mapping_(nullptr)
+{
+
+}
+
+LevelArchive::~LevelArchive()
+{
+	close();
+}
+
+// 映射关卡包文件
+bool LevelArchive::open(const std::string &filename)
+{
+	close();
+
+	size_t size = 0;
+	mapping_ = map_file(filename, size);
+	if (mapping_ == nullptr)
+	{
+		return false;
+	}
+
+	data_ = static_cast<const uint8_t *>(mapping_);
+	size_ = size;
+	if (!validate())
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+// 从内存读取关卡包
+bool LevelArchive::open_memory(const void *data, size_t size)
+{
+	close();
+	if (data == nullptr || size == 0)
+	{
+		return false;
+	}
+
+	buffer_.resize((size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+	memcpy(&buffer_[0], data, size);
+	data_ = reinterpret_cast<const uint8_t *>(&buffer_[0]);
+	size_ = size;
+	if (!validate())
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+// 关闭
+void LevelArchive::close()
+{
+	if (mapping_ != nullptr)
+	{
+		unmap_file(mapping_, size_);
+		mapping_ = nullptr;
+	}
+	std::vector<uint64_t>().swap(buffer_);
+	data_ = nullptr;
+	size_ = 0;
+	level_num_ = 0;
+}
+
+// 关卡数量
+size_t LevelArchive::level_num() const
+{
+	return level_num_;
+}
+
+// 按索引获取关卡
+bool LevelArchive::get_level(size_t index, Level &ret) const
+{
+	if (index >= level_num_)
+	{
+		return false;
+	}
+
+	const uint8_t *entry = data_ + kHeaderSize + index * kEntrySize;
+	ret.level = read_value<uint32_t>(entry);
+	ret.width = read_value<uint16_t>(entry + 4);
+	ret.height = read_value<uint16_t>(entry + 6);
+	ret.type_num = read_value<uint16_t>(entry + 8);
+	ret.rows = reinterpret_cast<const uint64_t *>(data_ + read_value<uint32_t>(entry + 12));
+	return true;
+}
+
+// 按编号查找关卡
+// 索引按编号升序，二分查找
+bool LevelArchive::find_level(uint32_t level, Level &ret) const
+{
+	size_t begin = 0;
+	size_t end = level_num_;
+	while (begin < end)
+	{
+		const size_t mid = begin + (end - begin) / 2;
+		const uint32_t value = read_value<uint32_t>(data_ + kHeaderSize + mid * kEntrySize);
+		if (value < level)
+		{
+			begin = mid + 1;
+		}
+		else if (value > level)
+		{
+			end = mid;
+		}
+		else
+		{
+			return get_level(mid, ret);
+		}
+	}
+	return false;
+}
+
+// 打包关卡
+bool LevelArchive::build(const std::map<uint32_t, CheckerboardConfig> &levels, std::vector<uint8_t> &ret)
+{
+	ret.clear();
+	write_value<uint32_t>(ret, kMagic);
+	write_value<uint16_t>(ret, kVersion);
+	write_value<uint16_t>(ret, 0);
+	write_value<uint32_t>(ret, static_cast<uint32_t>(levels.size()));
+	write_value<uint32_t>(ret, 0);
+
+	// 布局数据紧跟在索引之后
+	size_t offset = kHeaderSize + levels.size() * kEntrySize;
+	offset = (offset + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+	for (auto &item : levels)
+	{
+		const CheckerboardConfig &config = item.second;
+		if (config.width <= 0 || config.width > kMaxWidth || config.height <= 0 || config.height > UINT16_MAX
+			|| config.type_num <= 0 || config.type_num > UINT16_MAX
+			|| config.layout.size() != static_cast<size_t>(config.width * config.height))
+		{
+			ret.clear();
+			return false;
+		}
+
+		write_value<uint32_t>(ret, item.first);
+		write_value<uint16_t>(ret, static_cast<uint16_t>(config.width));
+		write_value<uint16_t>(ret, static_cast<uint16_t>(config.height));
+		write_value<uint16_t>(ret, static_cast<uint16_t>(config.type_num));
+		write_value<uint16_t>(ret, 0);
+		write_value<uint32_t>(ret, static_cast<uint32_t>(offset));
+		offset += config.height * sizeof(uint64_t);
+	}
+
+	ret.resize((ret.size() + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1), 0);
+	for (auto &item : levels)
+	{
+		const CheckerboardConfig &config = item.second;
+		for (int row = 0; row < config.height; ++row)
+		{
+			uint64_t line = 0;
+			for (int col = 0; col < config.width; ++col)
+			{
+				if (config.layout[row * config.width + col])
+				{
+					line |= uint64_t(1) << col;
+				}
+			}
+			write_value<uint64_t>(ret, line);
+		}
+	}
+	return true;
+}
+
+// 校验数据
+// 布局数据按原样使用，只支持小端平台
+bool LevelArchive::validate()
+{
+	if (size_ < kHeaderSize
+		|| read_value<uint32_t>(data_) != kMagic
+		|| read_value<uint16_t>(data_ + 4) != kVersion)
+	{
+		return false;
+	}
+
+	const uint64_t level_num = read_value<uint32_t>(data_ + 8);
+	if (level_num > (size_ - kHeaderSize) / kEntrySize)
+	{
+		return false;
+	}
+
+	for (uint64_t i = 0; i < level_num; ++i)
+	{
+		const uint8_t *entry = data_ + kHeaderSize + i * kEntrySize;
+		const uint32_t level = read_value<uint32_t>(entry);
+		const int width = read_value<uint16_t>(entry + 4);
+		const uint64_t height = read_value<uint16_t>(entry + 6);
+		const uint64_t offset = read_value<uint32_t>(entry + 12);
+		if (width == 0 || width > kMaxWidth || height == 0 || read_value<uint16_t>(entry + 8) == 0
+			|| offset % sizeof(uint64_t) != 0 || offset + height * sizeof(uint64_t) > size_
+			|| (i > 0 && read_value<uint32_t>(entry - kEntrySize) >= level))
+		{
+			return false;
+		}
+	}
+
+	level_num_ = static_cast<size_t>(level_num);
+	return true;
+}
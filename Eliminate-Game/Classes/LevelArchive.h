@@ -0,0 +1,126 @@
+﻿/**
+ * 关卡包
+ * 由离线工具把所有关卡的布局打包成一个文件，运行时映射到内存直接使用，不需要解析
+ *
+ * 二进制格式(小端):
+ *   uint32  magic       'EGLV'
+ *   uint16  version
+ *   uint16  reserved
+ *   uint32  level_num   关卡数量
+ *   uint32  reserved
+ *   索引，按关卡编号升序，每项16字节:
+ *     uint32  level     关卡编号
+ *     uint16  width
+ *     uint16  height
+ *     uint16  type_num
+ *     uint16  reserved
+ *     uint32  offset    布局数据在文件中的位置，8字节对齐
+ *   布局数据，每个关卡 height 个 uint64，第y个的第x位表示(x, y)是否为地板
+ */
+
+#ifndef __LEVELARCHIVE_H__
+#define __LEVELARCHIVE_H__
+
+#include <map>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "CheckerboardConfig.h"
+
+class LevelArchive
+{
+public:
+	static const uint32_t kMagic = 0x564C4745;		// 'EGLV'
+	static const uint16_t kVersion = 1;
+	static const size_t kHeaderSize = 16;
+	static const size_t kEntrySize = 16;
+	static const int kMaxWidth = 64;
+
+	/**
+	 * 关卡视图
+	 * 直接指向关卡包的数据，关卡包关闭后失效
+	 */
+	struct Level
+	{
+		uint32_t			level;
+		int					width;
+		int					height;
+		int					type_num;
+		const uint64_t*		rows;		// 每行一个位图
+
+		/**
+		 * 是否为地板
+		 */
+		bool is_floor(int x, int y) const
+		{
+			return (rows[y] >> x) & 1;
+		}
+
+		/**
+		 * 转换为棋盘配置
+		 */
+		void to_config(CheckerboardConfig &ret) const;
+	};
+
+public:
+	LevelArchive();
+
+	~LevelArchive();
+
+	/**
+	 * 映射关卡包文件
+	 */
+	bool open(const std::string &filename);
+
+	/**
+	 * 从内存读取关卡包，用于无法映射文件的平台
+	 * 数据会被复制一份
+	 */
+	bool open_memory(const void *data, size_t size);
+
+	/**
+	 * 关闭
+	 */
+	void close();
+
+	/**
+	 * 关卡数量
+	 */
+	size_t level_num() const;
+
+	/**
+	 * 按索引获取关卡
+	 */
+	bool get_level(size_t index, Level &ret) const;
+
+	/**
+	 * 按编号查找关卡
+	 */
+	bool find_level(uint32_t level, Level &ret) const;
+
+	/**
+	 * 打包关卡
+	 * @return 棋盘宽度超过kMaxWidth或配置不完整返回false
+	 */
+	static bool build(const std::map<uint32_t, CheckerboardConfig> &levels, std::vector<uint8_t> &ret);
+
+protected:
+	LevelArchive(const LevelArchive&) = delete;
+	LevelArchive& operator= (const LevelArchive&) = delete;
+
+private:
+	/**
+	 * 校验数据
+	 */
+	bool validate();
+
+private:
+	const uint8_t*			data_;
+	size_t					size_;
+	size_t					level_num_;
+	void*					mapping_;		// 映射的文件，使用内存读取时为nullptr
+	std::vector<uint64_t>	buffer_;		// 从内存读取时复制的数据，保证按8字节对齐
+};
+
+#endif
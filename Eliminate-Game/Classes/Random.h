@@ -0,0 +1,84 @@
+﻿/**
+ * 随机数生成器
+ * PCG32算法，相同种子在任何平台、任何标准库下都生成相同的序列，用于回放
+ */
+
+#ifndef __RANDOM_H__
+#define __RANDOM_H__
+
+#include <cstdint>
+
+class Random
+{
+public:
+	explicit Random(uint64_t seed = 0);
+
+	/**
+	 * 设置种子
+	 */
+	void seed(uint64_t seed);
+
+	/**
+	 * 生成32位随机数
+	 */
+	uint32_t next();
+
+	/**
+	 * 生成[min, max]区间内均匀分布的整数
+	 */
+	int next_int(int min, int max);
+
+private:
+	uint64_t	state_;
+};
+
+inline Random::Random(uint64_t seed)
+	: state_(0)
+{
+	this->seed(seed);
+}
+
+inline void Random::seed(uint64_t seed)
+{
+	state_ = 0;
+	next();
+	state_ += seed;
+	next();
+}
+
+inline uint32_t Random::next()
+{
+	static const uint64_t kMultiplier = 6364136223846793005ULL;
+	static const uint64_t kIncrement = 1442695040888963407ULL;
+
+	const uint64_t old = state_;
+	state_ = old * kMultiplier + kIncrement;
+	const uint32_t xorshifted = static_cast<uint32_t>(((old >> 18) ^ old) >> 27);
+	const uint32_t rot = static_cast<uint32_t>(old >> 59);
+	return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+}
+
+// 乘法取高位映射到区间，拒绝低位落在偏差区间内的结果，避免除法
+inline int Random::next_int(int min, int max)
+{
+	const uint32_t range = static_cast<uint32_t>(max - min) + 1;
+	if (range == 0)
+	{
+		return static_cast<int>(next());
+	}
+
+	uint64_t m = static_cast<uint64_t>(next()) * range;
+	uint32_t low = static_cast<uint32_t>(m);
+	if (low < range)
+	{
+		const uint32_t threshold = (0u - range) % range;
+		while (low < threshold)
+		{
+			m = static_cast<uint64_t>(next()) * range;
+			low = static_cast<uint32_t>(m);
+		}
+	}
+	return min + static_cast<int>(m >> 32);
+}
+
+#endif
@@ -0,0 +1,231 @@
+﻿#include "Replay.h"
+
+#include <cstdio>
+#include <cassert>
+
+namespace
+{
+	const int kOffsets[4][2] = { { 1, 0 }, { 0, 1 }, { -1, 0 }, { 0, -1 } };
+
+	// 格子索引占14位
+	const int kMaxCellIndex = 1 << 14;
+
+	template <typename T>
+	void write_value(std::vector<uint8_t> &out, T value)
+	{
+		for (size_t i = 0; i < sizeof(T); ++i)
+		{
+			out.push_back(static_cast<uint8_t>(value >> (i * 8)));
+		}
+	}
+
+	template <typename T>
+	T read_value(const uint8_t *data)
+	{
+		T value = 0;
+		for (size_t i = 0; i < sizeof(T); ++i)
+		{
+			value |= static_cast<T>(data[i]) << (i * 8);
+		}
+		return value;
+	}
+}
+
+
+Replay::Replay()
+	: level_(0)
+	, seed_(0)
+	, score_(0)
+	, checksum_(0)
+{
+
+}
+
+// 重置
+void Replay::reset(uint32_t level, uint64_t seed)
+{
+	level_ = level;
+	seed_ = seed;
+	score_ = 0;
+	checksum_ = 0;
+	moves_.clear();
+}
+
+// 记录交换
+bool Replay::add_swap(const GameLogic::Vec2 &a, const GameLogic::Vec2 &b, int width)
+{
+	const int idx = a.y * width + a.x;
+	if (a.x < 0 || a.x >= width || a.y < 0 || idx >= kMaxCellIndex)
+	{
+		return false;
+	}
+
+	for (int dir = 0; dir < 4; ++dir)
+	{
+		if (b.x == a.x + kOffsets[dir][0] && b.y == a.y + kOffsets[dir][1])
+		{
+			moves_.push_back(static_cast<uint16_t>((idx << 2) | dir));
+			return true;
+		}
+	}
+	return false;
+}
+
+// 解码交换
+void Replay::decode_swap(uint16_t move, int width, GameLogic::Vec2 &a, GameLogic::Vec2 &b)
+{
+	assert(width > 0);
+	const int idx = move >> 2;
+	const int dir = move & 3;
+	a.x = idx % width;
+	a.y = idx / width;
+	b.x = a.x + kOffsets[dir][0];
+	b.y = a.y + kOffsets[dir][1];
+}
+
+// 记录结果
+void Replay::set_result(uint32_t score, uint64_t checksum)
+{
+	score_ = score;
+	checksum_ = checksum;
+}
+
+// 计算棋盘校验值
+// FNV-1a
+uint64_t Replay::checkerboard_checksum(const std::vector<int> &checkerboard)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (int type : checkerboard)
+	{
+		hash ^= static_cast<uint32_t>(type);
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+// 在游戏逻辑上重放
+bool Replay::play(GameLogic &logic, const CheckerboardConfig &config,
+				  const std::function<void(const GameLogic::ActionGroup&)> &visitor) const
+{
+	auto drain = [&]()
+	{
+		while (logic.get_action_group_num() > 0)
+		{
+			GameLogic::ActionGroup group = logic.take_action_group_from_queue();
+			if (visitor)
+			{
+				visitor(group);
+			}
+		}
+	};
+
+	logic.start_game(config, seed_);
+	drain();
+
+	GameLogic::Vec2 a, b;
+	for (uint16_t move : moves_)
+	{
+		decode_swap(move, config.width, a, b);
+		logic.swap_and_eliminate(a, b);
+		drain();
+	}
+
+	return static_cast<uint32_t>(logic.get_score()) == score_
+		&& checkerboard_checksum(logic.get_checkerboard()) == checksum_;
+}
+
+// 序列化
+void Replay::serialize(std::vector<uint8_t> &out) const
+{
+	out.reserve(out.size() + kHeaderSize + moves_.size() * sizeof(uint16_t));
+	write_value<uint32_t>(out, kMagic);
+	write_value<uint16_t>(out, kVersion);
+	write_value<uint16_t>(out, 0);
+	write_value<uint32_t>(out, level_);
+	write_value<uint64_t>(out, seed_);
+	write_value<uint32_t>(out, score_);
+	write_value<uint64_t>(out, checksum_);
+	write_value<uint32_t>(out, static_cast<uint32_t>(moves_.size()));
+	for (uint16_t move : moves_)
+	{
+		write_value<uint16_t>(out, move);
+	}
+}
+
+// 反序列化
+size_t Replay::deserialize(const uint8_t *data, size_t size)
+{
+	if (size < kHeaderSize
+		|| read_value<uint32_t>(data) != kMagic
+		|| read_value<uint16_t>(data + 4) != kVersion)
+	{
+		return 0;
+	}
+
+	const uint32_t move_num = read_value<uint32_t>(data + 32);
+	if ((size - kHeaderSize) / sizeof(uint16_t) < move_num)
+	{
+		return 0;
+	}
+
+	level_ = read_value<uint32_t>(data + 8);
+	seed_ = read_value<uint64_t>(data + 12);
+	score_ = read_value<uint32_t>(data + 20);
+	checksum_ = read_value<uint64_t>(data + 24);
+	moves_.resize(move_num);
+	const uint8_t *moves = data + kHeaderSize;
+	for (uint32_t i = 0; i < move_num; ++i)
+	{
+		moves_[i] = read_value<uint16_t>(moves + i * sizeof(uint16_t));
+	}
+	return kHeaderSize + move_num * sizeof(uint16_t);
+}
+
+// 保存到文件
+bool Replay::save_to_file(const std::string &filename) const
+{
+	std::vector<uint8_t> data;
+	serialize(data);
+
+	FILE *file = fopen(filename.c_str(), "wb");
+	if (file == nullptr)
+	{
+		return false;
+	}
+	const bool ok = fwrite(&data[0], 1, data.size(), file) == data.size();
+	fclose(file);
+	return ok;
+}
+
+// 从文件读取所有记录
+bool Replay::load_from_file(const std::string &filename, std::vector<Replay> &ret)
+{
+	FILE *file = fopen(filename.c_str(), "rb");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	std::vector<uint8_t> data;
+	uint8_t buffer[4096];
+	size_t bytes = 0;
+	while ((bytes = fread(buffer, 1, sizeof(buffer), file)) > 0)
+	{
+		data.insert(data.end(), buffer, buffer + bytes);
+	}
+	fclose(file);
+
+	size_t offset = 0;
+	while (offset < data.size())
+	{
+		Replay replay;
+		const size_t used = replay.deserialize(&data[offset], data.size() - offset);
+		if (used == 0)
+		{
+			return false;
+		}
+		ret.push_back(std::move(replay));
+		offset += used;
+	}
+	return true;
+}
@@ -0,0 +1,118 @@
+﻿/**
+ * 对局回放
+ * 记录种子、关卡编号与交换序列，在无界面环境下可以重建完全相同的棋盘与动作序列
+ *
+ * 二进制格式(小端):
+ *   uint32  magic       'EGRP'
+ *   uint16  version
+ *   uint16  reserved
+ *   uint32  level       关卡编号
+ *   uint64  seed        随机种子
+ *   uint32  score       得分
+ *   uint64  checksum    结束时的棋盘校验值
+ *   uint32  move_num    交换次数
+ *   uint16  moves[]     (格子索引 << 2) | 方向
+ * 每条记录自带长度，多条记录可以直接首尾相接写入同一个文件
+ */
+
+#ifndef __REPLAY_H__
+#define __REPLAY_H__
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include "GameLogic.h"
+
+class Replay
+{
+public:
+	/**
+	 * 交换方向
+	 */
+	enum Direction
+	{
+		RIGHT = 0,
+		UP = 1,
+		LEFT = 2,
+		DOWN = 3,
+	};
+
+	static const uint32_t kMagic = 0x50524745;		// 'EGRP'
+	static const uint16_t kVersion = 1;
+	static const size_t kHeaderSize = 36;
+
+public:
+	Replay();
+
+	/**
+	 * 重置
+	 */
+	void reset(uint32_t level, uint64_t seed);
+
+	/**
+	 * 记录交换
+	 * @return 两个位置不相邻或超出编码范围返回false
+	 */
+	bool add_swap(const GameLogic::Vec2 &a, const GameLogic::Vec2 &b, int width);
+
+	/**
+	 * 解码交换
+	 */
+	static void decode_swap(uint16_t move, int width, GameLogic::Vec2 &a, GameLogic::Vec2 &b);
+
+	/**
+	 * 记录结果
+	 */
+	void set_result(uint32_t score, uint64_t checksum);
+
+	/**
+	 * 计算棋盘校验值
+	 */
+	static uint64_t checkerboard_checksum(const std::vector<int> &checkerboard);
+
+	/**
+	 * 在游戏逻辑上重放
+	 * @param visitor 每个动作组的回调，可以为空
+	 * @return 得分与棋盘校验值都与记录一致返回true
+	 */
+	bool play(GameLogic &logic, const CheckerboardConfig &config,
+			  const std::function<void(const GameLogic::ActionGroup&)> &visitor = nullptr) const;
+
+	/**
+	 * 序列化，追加到out末尾
+	 */
+	void serialize(std::vector<uint8_t> &out) const;
+
+	/**
+	 * 反序列化
+	 * @return 读取的字节数，失败返回0
+	 */
+	size_t deserialize(const uint8_t *data, size_t size);
+
+	/**
+	 * 保存到文件
+	 */
+	bool save_to_file(const std::string &filename) const;
+
+	/**
+	 * 从文件读取所有记录
+	 */
+	static bool load_from_file(const std::string &filename, std::vector<Replay> &ret);
+
+public:
+	uint32_t level() const { return level_; }
+	uint64_t seed() const { return seed_; }
+	uint32_t score() const { return score_; }
+	uint64_t checksum() const { return checksum_; }
+	const std::vector<uint16_t>& moves() const { return moves_; }
+
+private:
+	uint32_t				level_;
+	uint64_t				seed_;
+	uint32_t				score_;
+	uint64_t				checksum_;
+	std::vector<uint16_t>	moves_;
+};
+
+#endif
@@ -0,0 +1,96 @@
+﻿#include "ReplayValidator.h"
+
+#include <unordered_map>
+
+namespace
+{
+	// 每块的对局数量，太小时窃取开销变大，太大时负载不均
+	const size_t kGrain = 8;
+}
+
+
+ReplayValidator::ReplayValidator(size_t thread_num)
+	: pool_(thread_num)
+{
+	for (size_t i = 0; i < pool_.thread_num(); ++i)
+	{
+		logics_.emplace_back(new GameLogic());
+	}
+}
+
+// 线程数量
+size_t ReplayValidator::thread_num() const
+{
+	return pool_.thread_num();
+}
+
+// 校验对局
+size_t ReplayValidator::validate(const std::vector<Replay> &replays, const LevelQuery &query, std::vector<Result> &ret)
+{
+	// 先在当前线程查询所有关卡，工作线程只读访问
+	std::unordered_map<uint32_t, const CheckerboardConfig *> levels;
+	std::vector<const CheckerboardConfig *> configs(replays.size(), nullptr);
+	for (size_t i = 0; i < replays.size(); ++i)
+	{
+		const uint32_t level = replays[i].level();
+		auto itr = levels.find(level);
+		if (itr == levels.end())
+		{
+			itr = levels.insert(std::make_pair(level, query ? query(level) : nullptr)).first;
+		}
+		configs[i] = itr->second;
+	}
+
+	ret.resize(replays.size());
+	std::vector<size_t> passed(pool_.thread_num(), 0);
+	pool_.parallel_for(replays.size(), kGrain, [&](size_t worker, size_t begin, size_t end)
+	{
+		GameLogic &logic = *logics_[worker];
+		for (size_t i = begin; i < end; ++i)
+		{
+			ret[i] = validate_one(logic, replays[i], configs[i]);
+			if (ret[i].status == Status::PASSED)
+			{
+				++passed[worker];
+			}
+		}
+	});
+
+	size_t num = 0;
+	for (size_t count : passed)
+	{
+		num += count;
+	}
+	return num;
+}
+
+// 校验单个对局
+ReplayValidator::Result ReplayValidator::validate_one(GameLogic &logic, const Replay &replay, const CheckerboardConfig *config)
+{
+	Result result;
+	result.status = Status::UNKNOWN_LEVEL;
+	result.score = 0;
+	result.checksum = 0;
+	if (config == nullptr)
+	{
+		return result;
+	}
+
+	// 超出棋盘的交换会被逻辑忽略，但说明记录已被篡改
+	GameLogic::Vec2 a, b;
+	for (uint16_t move : replay.moves())
+	{
+		Replay::decode_swap(move, config->width, a, b);
+		if (a.y >= config->height || b.x < 0 || b.x >= config->width || b.y < 0 || b.y >= config->height)
+		{
+			result.status = Status::INVALID_MOVE;
+			return result;
+		}
+	}
+
+	const bool ok = replay.play(logic, *config);
+	result.status = ok ? Status::PASSED : Status::MISMATCH;
+	result.score = static_cast<uint32_t>(logic.get_score());
+	result.checksum = Replay::checkerboard_checksum(logic.get_checkerboard());
+	return result;
+}
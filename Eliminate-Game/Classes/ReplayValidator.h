@@ -0,0 +1,74 @@
+﻿/**
+ * 批量回放校验
+ * 在工作窃取线程池上并行重放大量对局，每个工作线程使用独立的游戏逻辑
+ */
+
+#ifndef __REPLAYVALIDATOR_H__
+#define __REPLAYVALIDATOR_H__
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include "Replay.h"
+#include "GameLogic.h"
+#include "WorkStealingPool.h"
+
+class ReplayValidator
+{
+public:
+	/**
+	 * 关卡查询
+	 * 只在调用validate的线程上调用，每个关卡编号只查询一次
+	 * @return 找不到关卡返回nullptr
+	 */
+	typedef std::function<const CheckerboardConfig*(uint32_t level)> LevelQuery;
+
+	/**
+	 * 校验结果
+	 */
+	enum class Status
+	{
+		PASSED,				// 通过
+		MISMATCH,			// 得分或棋盘不一致
+		UNKNOWN_LEVEL,		// 关卡不存在
+		INVALID_MOVE,		// 交换位置超出棋盘
+	};
+
+	struct Result
+	{
+		Status			status;
+		uint32_t		score;			// 重放得到的得分
+		uint64_t		checksum;		// 重放得到的棋盘校验值
+	};
+
+public:
+	/**
+	 * @param thread_num 线程数量，为0时使用硬件线程数
+	 */
+	explicit ReplayValidator(size_t thread_num = 0);
+
+	/**
+	 * 线程数量
+	 */
+	size_t thread_num() const;
+
+	/**
+	 * 校验对局
+	 * @param ret 与replays一一对应的结果
+	 * @return 通过的数量
+	 */
+	size_t validate(const std::vector<Replay> &replays, const LevelQuery &query, std::vector<Result> &ret);
+
+private:
+	/**
+	 * 校验单个对局
+	 */
+	static Result validate_one(GameLogic &logic, const Replay &replay, const CheckerboardConfig *config);
+
+private:
+	WorkStealingPool							pool_;
+	std::vector< std::unique_ptr<GameLogic> >	logics_;			// 每个工作线程一个
+};
+
+#endif
@@ -0,0 +1,340 @@
+﻿#include "StaticBatch.h"
+
+#include <cstring>
+#include <typeinfo>
+using namespace cocos2d;
+
+
+namespace
+{
+	// 逐字节比较
+	template <typename T>
+	bool is_same_bytes(const T &a, const T &b)
+	{
+		return memcmp(&a, &b, sizeof(T)) == 0;
+	}
+}
+
+StaticBatch::StaticBatch()
+	: captured_(false)
+	, cacheable_(false)
+	, uploaded_(false)
+	, children_stale_(false)
+	, child_num_(0)
+	, sprite_program_(nullptr)
+{
+	buffers_[0] = buffers_[1] = 0;
+}
+
+StaticBatch::~StaticBatch()
+{
+	clear_states();
+	if (buffers_[0] != 0)
+	{
+		glDeleteBuffers(2, buffers_);
+	}
+	CC_SAFE_RELEASE(sprite_program_);
+}
+
+bool StaticBatch::init()
+{
+	if (!Node::init())
+	{
+		return false;
+	}
+
+	setGLProgramState(GLProgramState::getOrCreateWithGLProgramName(GLProgram::SHADER_NAME_POSITION_TEXTURE_COLOR));
+	sprite_program_ = GLProgramState::getOrCreateWithGLProgramName(GLProgram::SHADER_NAME_POSITION_TEXTURE_COLOR_NO_MVP);
+	sprite_program_->retain();
+
+#if CC_ENABLE_CACHE_TEXTURE_DATA
+	// 渲染环境重建后缓冲失效，下次绘制时重新创建
+	auto listener = EventListenerCustom::create(EVENT_RENDERER_RECREATED, [this](EventCustom *event)
+	{
+		buffers_[0] = buffers_[1] = 0;
+		uploaded_ = false;
+	});
+	_eventDispatcher->addEventListenerWithSceneGraphPriority(listener, this);
+#endif
+
+	return true;
+}
+
+// 丢弃缓存
+void StaticBatch::invalidate()
+{
+	captured_ = false;
+}
+
+// 子树是否以缓存绘制
+bool StaticBatch::is_cached() const
+{
+	return captured_ && cacheable_;
+}
+
+// 遍历
+void StaticBatch::visit(Renderer *renderer, const Mat4 &parent_transform, uint32_t parent_flags)
+{
+	if (!_visible)
+	{
+		return;
+	}
+
+	uint32_t flags = processParentFlags(parent_transform, parent_flags);
+	if (!captured_ || is_changed())
+	{
+		capture();
+	}
+
+	// 顶点在本节点坐标系中，本节点移动只改变绘制时的矩阵
+	if (cacheable_)
+	{
+		draw(renderer, _modelViewTransform, flags);
+		children_stale_ = true;
+		return;
+	}
+
+	// 缓存期间子节点没有遍历，恢复普通绘制时重新计算矩阵
+	if (children_stale_)
+	{
+		flags |= FLAGS_TRANSFORM_DIRTY;
+		children_stale_ = false;
+	}
+	Node::visit(renderer, parent_transform, flags);
+}
+
+// 绘制
+void StaticBatch::draw(Renderer *renderer, const Mat4 &transform, uint32_t flags)
+{
+	if (!cacheable_ || quads_.empty())
+	{
+		return;
+	}
+
+	command_.init(_globalZOrder);
+	command_.func = CC_CALLBACK_0(StaticBatch::on_draw, this, transform, flags);
+	renderer->addCommand(&command_);
+}
+
+// 释放收集的节点
+void StaticBatch::clear_states()
+{
+	for (auto &state : states_)
+	{
+		state.node->release();
+	}
+	states_.clear();
+}
+
+// 子树是否与收集时不同
+// 精灵的颜色、纹理区域等变化不会标记节点，所以逐个比较收集时的状态
+bool StaticBatch::is_changed() const
+{
+	if (getChildrenCount() != child_num_)
+	{
+		return true;
+	}
+
+	for (const auto &state : states_)
+	{
+		const Node *node = state.node;
+		if (node->getParent() != state.parent
+			|| node->getChildrenCount() != state.child_num
+			|| node->getLocalZOrder() != state.local_z
+			|| node->isVisible() != state.visible)
+		{
+			return true;
+		}
+
+		// 隐藏节点的子树不绘制，重新显示时才需要收集
+		if (!state.visible)
+		{
+			continue;
+		}
+
+		if (!is_same_bytes(node->getNodeToParentTransform(), state.transform))
+		{
+			return true;
+		}
+
+		const Sprite *sprite = state.sprite;
+		if (sprite != nullptr
+			&& (sprite->getTexture() != state.texture
+			|| !(sprite->getBlendFunc() == state.blend_func)
+			|| sprite->getGLProgramState() != state.program_state
+			|| sprite->getGlobalZOrder() != state.global_z
+			|| !is_same_bytes(sprite->getQuad(), state.quad)))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+// 收集子树
+void StaticBatch::capture()
+{
+	clear_states();
+	quads_.clear();
+	ranges_.clear();
+	captured_ = true;
+	cacheable_ = true;
+	uploaded_ = false;
+	child_num_ = getChildrenCount();
+
+	// 与Node::visit的顺序一致
+	sortAllChildren();
+	capture_children(this, Mat4::IDENTITY, true);
+	capture_children(this, Mat4::IDENTITY, false);
+
+	if (quads_.size() > kMaxQuads)
+	{
+		cacheable_ = false;
+	}
+}
+
+// 按绘制顺序收集节点
+// 无法缓存时也收集完整个子树，子树变化后再尝试缓存
+void StaticBatch::capture_node(Node *node, const Mat4 &transform)
+{
+	NodeState state;
+	state.node = node;
+	state.node->retain();
+	state.parent = node->getParent();
+	state.child_num = node->getChildrenCount();
+	state.local_z = node->getLocalZOrder();
+	state.visible = node->isVisible();
+	state.transform = node->getNodeToParentTransform();
+	state.sprite = nullptr;
+	state.texture = nullptr;
+	state.program_state = nullptr;
+	state.global_z = 0.0f;
+
+	// 子类可能有自己的绘制，只接受Node和Sprite
+	const std::type_info &type = typeid(*node);
+	if (type == typeid(Sprite))
+	{
+		auto sprite = static_cast<Sprite *>(node);
+		state.sprite = sprite;
+		state.quad = sprite->getQuad();
+		state.texture = sprite->getTexture();
+		state.blend_func = sprite->getBlendFunc();
+		state.program_state = sprite->getGLProgramState();
+		state.global_z = sprite->getGlobalZOrder();
+
+		if (state.texture == nullptr || state.program_state != sprite_program_ || state.global_z != _globalZOrder)
+		{
+			cacheable_ = false;
+		}
+	}
+	else if (type != typeid(Node))
+	{
+		cacheable_ = false;
+	}
+	states_.push_back(state);
+
+	if (!state.visible)
+	{
+		return;
+	}
+
+	const Mat4 node_transform = transform * state.transform;
+	node->sortAllChildren();
+	capture_children(node, node_transform, true);
+	if (state.sprite != nullptr)
+	{
+		append_sprite(state.sprite, node_transform);
+	}
+	capture_children(node, node_transform, false);
+}
+
+// 收集子节点
+void StaticBatch::capture_children(Node *node, const Mat4 &transform, bool negative_z)
+{
+	for (auto child : node->getChildren())
+	{
+		if ((child->getLocalZOrder() < 0) == negative_z)
+		{
+			capture_node(child, transform);
+		}
+	}
+}
+
+// 添加精灵的四边形
+void StaticBatch::append_sprite(Sprite *sprite, const Mat4 &transform)
+{
+	V3F_C4B_T2F_Quad quad = sprite->getQuad();
+	transform.transformPoints(reinterpret_cast<Vec3 *>(&quad.tl.vertices), 4, sizeof(V3F_C4B_T2F));
+	quads_.push_back(quad);
+
+	const GLuint texture = sprite->getTexture()->getName();
+	const BlendFunc &blend_func = sprite->getBlendFunc();
+	if (ranges_.empty() || ranges_.back().texture != texture || !(ranges_.back().blend_func == blend_func))
+	{
+		DrawRange range = { texture, blend_func, quads_.size() - 1, 0 };
+		ranges_.push_back(range);
+	}
+	++ranges_.back().count;
+}
+
+// 上传顶点和索引
+void StaticBatch::upload_buffers()
+{
+	if (buffers_[0] == 0)
+	{
+		glGenBuffers(2, buffers_);
+	}
+
+	std::vector<GLushort> indices(quads_.size() * 6);
+	for (size_t i = 0; i < quads_.size(); ++i)
+	{
+		indices[i * 6 + 0] = static_cast<GLushort>(i * 4 + 0);
+		indices[i * 6 + 1] = static_cast<GLushort>(i * 4 + 1);
+		indices[i * 6 + 2] = static_cast<GLushort>(i * 4 + 2);
+		indices[i * 6 + 3] = static_cast<GLushort>(i * 4 + 3);
+		indices[i * 6 + 4] = static_cast<GLushort>(i * 4 + 2);
+		indices[i * 6 + 5] = static_cast<GLushort>(i * 4 + 1);
+	}
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers_[1]);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort) * indices.size(), indices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	glBindBuffer(GL_ARRAY_BUFFER, buffers_[0]);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(V3F_C4B_T2F_Quad) * quads_.size(), quads_.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	uploaded_ = true;
+}
+
+// 渲染
+void StaticBatch::on_draw(const Mat4 &transform, uint32_t flags)
+{
+	if (!uploaded_)
+	{
+		upload_buffers();
+	}
+
+	auto program = getGLProgram();
+	program->use();
+	program->setUniformsForBuiltins(transform);
+
+	glBindBuffer(GL_ARRAY_BUFFER, buffers_[0]);
+	GL::enableVertexAttribs(GL::VERTEX_ATTRIB_FLAG_POS_COLOR_TEX);
+	glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(V3F_C4B_T2F), (GLvoid *)offsetof(V3F_C4B_T2F, vertices));
+	glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(V3F_C4B_T2F), (GLvoid *)offsetof(V3F_C4B_T2F, colors));
+	glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_TEX_COORD, 2, GL_FLOAT, GL_FALSE, sizeof(V3F_C4B_T2F), (GLvoid *)offsetof(V3F_C4B_T2F, texCoords));
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers_[1]);
+	for (const auto &range : ranges_)
+	{
+		GL::bindTexture2D(range.texture);
+		GL::blendFunc(range.blend_func.src, range.blend_func.dst);
+		glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(range.count * 6), GL_UNSIGNED_SHORT, (GLvoid *)(range.first * 6 * sizeof(GLushort)));
+	}
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	CC_INCREMENT_GL_DRAWN_BATCHES_AND_VERTICES(ranges_.size(), quads_.size() * 4);
+	CHECK_GL_ERROR_DEBUG();
+}
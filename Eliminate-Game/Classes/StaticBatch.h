@@ -0,0 +1,130 @@
+﻿/**
+ * 静态批次节点
+ * 第一次遍历时把子树中所有精灵的四边形变换到本节点坐标系，写入常驻的顶点缓冲，
+ * 之后每帧只提交一个自定义命令，不再遍历子节点、生成命令和变换顶点
+ * 子树中节点的矩阵、可见性、层级或精灵内容变化时重新收集
+ * 子树只能由Node和Sprite组成，精灵使用默认着色器且全局层级与本节点相同，否则按普通节点绘制
+ */
+
+#ifndef __STATICBATCH_H__
+#define __STATICBATCH_H__
+
+#include <vector>
+#include "cocos2d.h"
+
+class StaticBatch : public cocos2d::Node
+{
+	static const size_t kMaxQuads = 65536 / 4;		// 顶点索引为16位
+
+	/**
+	 * 节点收集时的状态
+	 */
+	struct NodeState
+	{
+		cocos2d::Node*				node;			// 持有引用
+		cocos2d::Node*				parent;
+		ssize_t						child_num;
+		int							local_z;
+		bool						visible;
+		cocos2d::Mat4				transform;		// 相对父节点的矩阵
+		cocos2d::Sprite*			sprite;			// 不是精灵时为nullptr
+		cocos2d::V3F_C4B_T2F_Quad	quad;
+		cocos2d::Texture2D*			texture;
+		cocos2d::BlendFunc			blend_func;
+		cocos2d::GLProgramState*	program_state;
+		float						global_z;
+	};
+
+	/**
+	 * 连续使用相同纹理和混合方式的四边形
+	 */
+	struct DrawRange
+	{
+		GLuint						texture;
+		cocos2d::BlendFunc			blend_func;
+		size_t						first;
+		size_t						count;
+	};
+
+public:
+	StaticBatch();
+
+	~StaticBatch();
+
+	CREATE_FUNC(StaticBatch);
+
+	virtual bool init() override;
+
+public:
+	/**
+	 * 丢弃缓存，下次遍历时重新收集
+	 */
+	void invalidate();
+
+	/**
+	 * 子树是否以缓存绘制
+	 */
+	bool is_cached() const;
+
+public:
+	virtual void visit(cocos2d::Renderer *renderer, const cocos2d::Mat4 &parent_transform, uint32_t parent_flags) override;
+
+	virtual void draw(cocos2d::Renderer *renderer, const cocos2d::Mat4 &transform, uint32_t flags) override;
+
+private:
+	/**
+	 * 释放收集的节点
+	 */
+	void clear_states();
+
+	/**
+	 * 子树是否与收集时不同
+	 */
+	bool is_changed() const;
+
+	/**
+	 * 收集子树
+	 */
+	void capture();
+
+	/**
+	 * 按绘制顺序收集节点
+	 * @param transform 节点到本节点的矩阵
+	 */
+	void capture_node(cocos2d::Node *node, const cocos2d::Mat4 &transform);
+
+	/**
+	 * 收集子节点
+	 */
+	void capture_children(cocos2d::Node *node, const cocos2d::Mat4 &transform, bool negative_z);
+
+	/**
+	 * 添加精灵的四边形
+	 */
+	void append_sprite(cocos2d::Sprite *sprite, const cocos2d::Mat4 &transform);
+
+	/**
+	 * 上传顶点和索引
+	 */
+	void upload_buffers();
+
+	/**
+	 * 渲染
+	 */
+	void on_draw(const cocos2d::Mat4 &transform, uint32_t flags);
+
+private:
+	bool										captured_;
+	bool										cacheable_;
+	bool										uploaded_;
+	bool										children_stale_;	// 缓存期间子节点的矩阵没有更新
+	ssize_t										child_num_;
+	cocos2d::GLProgramState*					sprite_program_;	// 精灵的默认着色器
+	cocos2d::CustomCommand						command_;
+	std::vector<NodeState>						states_;
+	std::vector<cocos2d::V3F_C4B_T2F_Quad>		quads_;
+	std::vector<DrawRange>						ranges_;
+	GLuint										buffers_[2];		// 顶点和索引
+};
+
+#endif
@@ -0,0 +1,153 @@
+﻿#include "WorkStealingPool.h"
+
+#include <cassert>
+#include <algorithm>
+
+
+WorkStealingPool::WorkStealingPool(size_t thread_num)
+	: task_(nullptr)
+	, generation_(0)
+	, running_(0)
+	, remaining_(0)
+	, stop_(false)
+{
+	if (thread_num == 0)
+	{
+		thread_num = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+	}
+
+	for (size_t i = 0; i < thread_num; ++i)
+	{
+		workers_.emplace_back(new Worker());
+	}
+	for (size_t i = 0; i < thread_num; ++i)
+	{
+		threads_.emplace_back(&WorkStealingPool::run, this, i);
+	}
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	start_cond_.notify_all();
+
+	for (auto &thread : threads_)
+	{
+		thread.join();
+	}
+}
+
+// 线程数量
+size_t WorkStealingPool::thread_num() const
+{
+	return threads_.size();
+}
+
+// 并行处理
+// 块按轮流的方式分配到各个线程，线程处理完自己的块后再去窃取
+void WorkStealingPool::parallel_for(size_t count, size_t grain, const Task &task)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	grain = std::max<size_t>(grain, 1);
+	const size_t chunks = (count + grain - 1) / grain;
+	for (size_t i = 0; i < chunks; ++i)
+	{
+		Range range;
+		range.begin = i * grain;
+		range.end = std::min(range.begin + grain, count);
+
+		Worker &worker = *workers_[i % workers_.size()];
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		worker.ranges.push_back(range);
+	}
+
+	std::unique_lock<std::mutex> lock(mutex_);
+	task_ = &task;
+	remaining_ = chunks;
+	running_ = threads_.size();
+	++generation_;
+	start_cond_.notify_all();
+
+	// 等待所有线程退出本次任务，之后task才可以释放
+	finish_cond_.wait(lock, [this]() { return running_ == 0; });
+	task_ = nullptr;
+}
+
+// 工作线程
+void WorkStealingPool::run(size_t index)
+{
+	size_t generation = 0;
+	while (true)
+	{
+		const Task *task = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			start_cond_.wait(lock, [&]() { return stop_ || generation_ != generation; });
+			if (stop_)
+			{
+				return;
+			}
+			generation = generation_;
+			task = task_;
+		}
+
+		Range range;
+		while (remaining_.load() > 0)
+		{
+			if (pop(index, range) || steal(index, range))
+			{
+				(*task)(index, range.begin, range.end);
+				--remaining_;
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (--running_ == 0)
+		{
+			finish_cond_.notify_one();
+		}
+	}
+}
+
+// 从自己队列的末尾取出
+bool WorkStealingPool::pop(size_t index, Range &ret)
+{
+	Worker &worker = *workers_[index];
+	std::lock_guard<std::mutex> lock(worker.mutex);
+	if (worker.ranges.empty())
+	{
+		return false;
+	}
+	ret = worker.ranges.back();
+	worker.ranges.pop_back();
+	return true;
+}
+
+// 从其他线程队列的头部窃取
+bool WorkStealingPool::steal(size_t index, Range &ret)
+{
+	const size_t num = workers_.size();
+	for (size_t i = 1; i < num; ++i)
+	{
+		Worker &victim = *workers_[(index + i) % num];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.ranges.empty())
+		{
+			ret = victim.ranges.front();
+			victim.ranges.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
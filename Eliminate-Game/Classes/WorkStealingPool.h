@@ -0,0 +1,85 @@
+﻿/**
+ * 工作窃取线程池
+ * 任务按块分配给每个工作线程，线程优先处理自己队列末尾的块，空闲时从其他线程队列头部窃取
+ */
+
+#ifndef __WORKSTEALINGPOOL_H__
+#define __WORKSTEALINGPOOL_H__
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <functional>
+#include <condition_variable>
+
+class WorkStealingPool
+{
+public:
+	/**
+	 * 任务函数
+	 * @param worker 工作线程编号，可用于访问线程独占的数据
+	 * @param begin 起始索引
+	 * @param end 结束索引(不包含)
+	 */
+	typedef std::function<void(size_t worker, size_t begin, size_t end)> Task;
+
+public:
+	/**
+	 * @param thread_num 线程数量，为0时使用硬件线程数
+	 */
+	explicit WorkStealingPool(size_t thread_num = 0);
+
+	~WorkStealingPool();
+
+	/**
+	 * 线程数量
+	 */
+	size_t thread_num() const;
+
+	/**
+	 * 并行处理[0, count)，阻塞直到全部完成
+	 * @param grain 每块的索引数量
+	 */
+	void parallel_for(size_t count, size_t grain, const Task &task);
+
+protected:
+	WorkStealingPool(const WorkStealingPool&) = delete;
+	WorkStealingPool& operator= (const WorkStealingPool&) = delete;
+
+private:
+	struct Range
+	{
+		size_t begin;
+		size_t end;
+	};
+
+	struct Worker
+	{
+		std::mutex			mutex;
+		std::deque<Range>	ranges;
+	};
+
+	void run(size_t index);
+
+	bool pop(size_t index, Range &ret);
+
+	bool steal(size_t index, Range &ret);
+
+private:
+	std::vector< std::unique_ptr<Worker> >	workers_;
+	std::vector<std::thread>				threads_;
+	std::mutex								mutex_;
+	std::condition_variable					start_cond_;
+	std::condition_variable					finish_cond_;
+	const Task*								task_;
+	size_t									generation_;		// 每次提交任务加一，唤醒工作线程
+	size_t									running_;			// 尚未退出本次任务的线程数量
+	std::atomic<size_t>						remaining_;			// 尚未完成的块数量
+	bool									stop_;
+};
+
+#endif
@@ -47,6 +47,7 @@ Configuration::Configuration()
 , _supportsBGRA8888(false)
 , _supportsDiscardFramebuffer(false)
 , _supportsShareableVAO(false)
+, _supportsPersistentBufferMapping(false)
 , _maxSamplesAllowed(0)
 , _maxTextureUnits(0)
 , _glExtensions(nullptr)
@@ -142,6 +143,9 @@ void Configuration::gatherGPUInfo()
     _supportsShareableVAO = checkForGLExtension("vertex_array_object");
 	_valueDict["gl.supports_vertex_array_object"] = Value(_supportsShareableVAO);
 
+    _supportsPersistentBufferMapping = checkForGLExtension("GL_ARB_buffer_storage") && checkForGLExtension("GL_ARB_sync");
+    _valueDict["gl.supports_persistent_buffer_mapping"] = Value(_supportsPersistentBufferMapping);
+
     CHECK_GL_ERROR_DEBUG();
 }
 
@@ -247,6 +251,11 @@ bool Configuration::supportsShareableVAO() const
 #endif
 }
 
+bool Configuration::supportsPersistentBufferMapping() const
+{
+    return _supportsPersistentBufferMapping;
+}
+
 //
 // generic getters for properties
 //
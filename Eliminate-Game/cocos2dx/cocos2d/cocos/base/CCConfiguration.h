@@ -110,6 +110,11 @@ public:
      */
 	bool supportsShareableVAO() const;
 
+    /** Whether or not buffers can be persistently mapped and synchronized with fences
+     (GL_ARB_buffer_storage and GL_ARB_sync).
+     */
+    bool supportsPersistentBufferMapping() const;
+
     /** returns whether or not an OpenGL is supported */
     bool checkForGLExtension(const std::string &searchName) const;
 
@@ -146,6 +151,7 @@ protected:
     bool            _supportsBGRA8888;
     bool            _supportsDiscardFramebuffer;
     bool            _supportsShareableVAO;
+    bool            _supportsPersistentBufferMapping;
     GLint           _maxSamplesAllowed;
     GLint           _maxTextureUnits;
     char *          _glExtensions;
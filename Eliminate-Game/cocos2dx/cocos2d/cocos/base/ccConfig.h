@@ -180,6 +180,22 @@ Only valid for cocos2d-mac. Not supported on cocos2d-ios.
     #endif
 #endif
 
+/** @def CC_USE_PERSISTENT_QUAD_BUFFER
+ If enabled, the Renderer writes batched quads straight into a persistently mapped, triple-buffered VBO
+ guarded by fences, instead of orphaning and re-filling the VBO on every flush.
+ It needs GL_ARB_buffer_storage and GL_ARB_sync at runtime and the matching GL headers at compile time,
+ otherwise the Renderer falls back to orphaning automatically.
+
+ To disable it set it to 0. Enabled by default on desktop platforms.
+ */
+#ifndef CC_USE_PERSISTENT_QUAD_BUFFER
+    #if (CC_TARGET_PLATFORM == CC_PLATFORM_WIN32) || (CC_TARGET_PLATFORM == CC_PLATFORM_MAC) || (CC_TARGET_PLATFORM == CC_PLATFORM_LINUX)
+        #define CC_USE_PERSISTENT_QUAD_BUFFER 1
+    #else
+        #define CC_USE_PERSISTENT_QUAD_BUFFER 0
+    #endif
+#endif
+
 
 /** @def CC_USE_LA88_LABELS
  If enabled, it will use LA88 (Luminance Alpha 16-bit textures) for LabelTTF objects.
@@ -885,6 +885,13 @@ void Mat4::transformPoint(const Vec3& point, Vec3* dst) const
     transformVector(point.x, point.y, point.z, 1.0f, dst);
 }
 
+void Mat4::transformPoints(Vec3* points, size_t count, size_t stride) const
+{
+    GP_ASSERT(points || count == 0);
+    GP_ASSERT(stride >= sizeof(Vec3));
+    MathUtil::transformVertices(m, (float*)points, count, stride);
+}
+
 void Mat4::transformVector(Vec3* vector) const
 {
     GP_ASSERT(vector);
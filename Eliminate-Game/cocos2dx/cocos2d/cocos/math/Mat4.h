@@ -761,6 +761,20 @@ public:
      */
     void transformPoint(const Vec3& point, Vec3* dst) const;
 
+    /**
+     * Transforms an array of points in place by this matrix.
+     *
+     * Each point is the first three floats of a vertex and consecutive vertices
+     * are stride bytes apart, so the positions of interleaved vertex formats
+     * such as V3F_C4B_T2F can be transformed without copying. The result is
+     * the same as calling transformPoint on every point.
+     *
+     * @param points The first point to transform.
+     * @param count The number of points.
+     * @param stride The distance in bytes between two consecutive points.
+     */
+    void transformPoints(Vec3* points, size_t count, size_t stride = sizeof(Vec3)) const;
+
     /**
      * Transforms the specified vector by this matrix by
      * treating the fourth (w) coordinate as zero.
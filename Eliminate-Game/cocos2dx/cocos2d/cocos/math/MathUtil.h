@@ -88,6 +88,15 @@ private:
 
     inline static void crossVec3(const float* v1, const float* v2, float* dst);
 
+    /**
+     * Transforms count points in place by m, with w taken as 1 and the resulting w dropped.
+     *
+     * The x, y and z of each point are the first three floats of a vertex and
+     * consecutive vertices are stride bytes apart, so interleaved vertex
+     * formats can be transformed without copying.
+     */
+    inline static void transformVertices(const float* m, float* vertices, size_t count, size_t stride);
+
     MathUtil();
 };
 
@@ -97,6 +106,8 @@ NS_CC_MATH_END
 
 #ifdef USE_NEON
 #include "MathUtilNeon.inl"
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include "MathUtilSSE.inl"
 #else
 #include "MathUtil.inl"
 #endif
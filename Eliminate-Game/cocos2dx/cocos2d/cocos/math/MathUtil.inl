@@ -191,4 +191,20 @@ inline void MathUtil::crossVec3(const float* v1, const float* v2, float* dst)
     dst[2] = z;
 }
 
+inline void MathUtil::transformVertices(const float* m, float* vertices, size_t count, size_t stride)
+{
+    char* p = (char*)vertices;
+    for (size_t i = 0; i < count; ++i)
+    {
+        float* v = (float*)(p + i * stride);
+        float x = v[0] * m[0] + v[1] * m[4] + v[2] * m[8] + m[12];
+        float y = v[0] * m[1] + v[1] * m[5] + v[2] * m[9] + m[13];
+        float z = v[0] * m[2] + v[1] * m[6] + v[2] * m[10] + m[14];
+
+        v[0] = x;
+        v[1] = y;
+        v[2] = z;
+    }
+}
+
 NS_CC_MATH_END
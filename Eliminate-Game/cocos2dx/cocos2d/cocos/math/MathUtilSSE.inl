@@ -0,0 +1,181 @@
+/**
+ SSE implementation of MathUtil, used on x86 and x86-64.
+
+ Matrices are column major, so a vector transform is a sum of the four
+ columns scaled by the vector components. Loads and stores are unaligned
+ because Mat4 and the vertex arrays are not guaranteed to be 16 byte aligned.
+
+ When the compiler targets AVX (-mavx, /arch:AVX) the batch vertex transform
+ processes two vertices per iteration in 256 bit registers.
+ */
+
+#include <xmmintrin.h>
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+NS_CC_MATH_BEGIN
+
+inline void MathUtil::addMatrix(const float* m, float scalar, float* dst)
+{
+    __m128 s = _mm_set1_ps(scalar);
+    _mm_storeu_ps(&dst[0],  _mm_add_ps(_mm_loadu_ps(&m[0]),  s));
+    _mm_storeu_ps(&dst[4],  _mm_add_ps(_mm_loadu_ps(&m[4]),  s));
+    _mm_storeu_ps(&dst[8],  _mm_add_ps(_mm_loadu_ps(&m[8]),  s));
+    _mm_storeu_ps(&dst[12], _mm_add_ps(_mm_loadu_ps(&m[12]), s));
+}
+
+inline void MathUtil::addMatrix(const float* m1, const float* m2, float* dst)
+{
+    _mm_storeu_ps(&dst[0],  _mm_add_ps(_mm_loadu_ps(&m1[0]),  _mm_loadu_ps(&m2[0])));
+    _mm_storeu_ps(&dst[4],  _mm_add_ps(_mm_loadu_ps(&m1[4]),  _mm_loadu_ps(&m2[4])));
+    _mm_storeu_ps(&dst[8],  _mm_add_ps(_mm_loadu_ps(&m1[8]),  _mm_loadu_ps(&m2[8])));
+    _mm_storeu_ps(&dst[12], _mm_add_ps(_mm_loadu_ps(&m1[12]), _mm_loadu_ps(&m2[12])));
+}
+
+inline void MathUtil::subtractMatrix(const float* m1, const float* m2, float* dst)
+{
+    _mm_storeu_ps(&dst[0],  _mm_sub_ps(_mm_loadu_ps(&m1[0]),  _mm_loadu_ps(&m2[0])));
+    _mm_storeu_ps(&dst[4],  _mm_sub_ps(_mm_loadu_ps(&m1[4]),  _mm_loadu_ps(&m2[4])));
+    _mm_storeu_ps(&dst[8],  _mm_sub_ps(_mm_loadu_ps(&m1[8]),  _mm_loadu_ps(&m2[8])));
+    _mm_storeu_ps(&dst[12], _mm_sub_ps(_mm_loadu_ps(&m1[12]), _mm_loadu_ps(&m2[12])));
+}
+
+inline void MathUtil::multiplyMatrix(const float* m, float scalar, float* dst)
+{
+    __m128 s = _mm_set1_ps(scalar);
+    _mm_storeu_ps(&dst[0],  _mm_mul_ps(_mm_loadu_ps(&m[0]),  s));
+    _mm_storeu_ps(&dst[4],  _mm_mul_ps(_mm_loadu_ps(&m[4]),  s));
+    _mm_storeu_ps(&dst[8],  _mm_mul_ps(_mm_loadu_ps(&m[8]),  s));
+    _mm_storeu_ps(&dst[12], _mm_mul_ps(_mm_loadu_ps(&m[12]), s));
+}
+
+inline void MathUtil::multiplyMatrix(const float* m1, const float* m2, float* dst)
+{
+    __m128 c0 = _mm_loadu_ps(&m1[0]);
+    __m128 c1 = _mm_loadu_ps(&m1[4]);
+    __m128 c2 = _mm_loadu_ps(&m1[8]);
+    __m128 c3 = _mm_loadu_ps(&m1[12]);
+
+    // Support the case where m1 or m2 is the same array as dst:
+    // every column is computed before anything is stored.
+    __m128 product[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        const float* v = &m2[i * 4];
+        __m128 r = _mm_mul_ps(c0, _mm_set1_ps(v[0]));
+        r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(v[1])));
+        r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(v[2])));
+        r = _mm_add_ps(r, _mm_mul_ps(c3, _mm_set1_ps(v[3])));
+        product[i] = r;
+    }
+
+    _mm_storeu_ps(&dst[0],  product[0]);
+    _mm_storeu_ps(&dst[4],  product[1]);
+    _mm_storeu_ps(&dst[8],  product[2]);
+    _mm_storeu_ps(&dst[12], product[3]);
+}
+
+inline void MathUtil::negateMatrix(const float* m, float* dst)
+{
+    __m128 zero = _mm_setzero_ps();
+    _mm_storeu_ps(&dst[0],  _mm_sub_ps(zero, _mm_loadu_ps(&m[0])));
+    _mm_storeu_ps(&dst[4],  _mm_sub_ps(zero, _mm_loadu_ps(&m[4])));
+    _mm_storeu_ps(&dst[8],  _mm_sub_ps(zero, _mm_loadu_ps(&m[8])));
+    _mm_storeu_ps(&dst[12], _mm_sub_ps(zero, _mm_loadu_ps(&m[12])));
+}
+
+inline void MathUtil::transposeMatrix(const float* m, float* dst)
+{
+    __m128 c0 = _mm_loadu_ps(&m[0]);
+    __m128 c1 = _mm_loadu_ps(&m[4]);
+    __m128 c2 = _mm_loadu_ps(&m[8]);
+    __m128 c3 = _mm_loadu_ps(&m[12]);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    _mm_storeu_ps(&dst[0],  c0);
+    _mm_storeu_ps(&dst[4],  c1);
+    _mm_storeu_ps(&dst[8],  c2);
+    _mm_storeu_ps(&dst[12], c3);
+}
+
+inline void MathUtil::transformVec4(const float* m, float x, float y, float z, float w, float* dst)
+{
+    __m128 r = _mm_mul_ps(_mm_loadu_ps(&m[0]), _mm_set1_ps(x));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(&m[4]),  _mm_set1_ps(y)));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(&m[8]),  _mm_set1_ps(z)));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(&m[12]), _mm_set1_ps(w)));
+
+    // dst may be a Vec3, only x, y and z are written
+    _mm_storel_pi((__m64*)dst, r);
+    _mm_store_ss(&dst[2], _mm_movehl_ps(r, r));
+}
+
+inline void MathUtil::transformVec4(const float* m, const float* v, float* dst)
+{
+    // Handle case where v == dst.
+    __m128 r = _mm_mul_ps(_mm_loadu_ps(&m[0]), _mm_set1_ps(v[0]));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(&m[4]),  _mm_set1_ps(v[1])));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(&m[8]),  _mm_set1_ps(v[2])));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(&m[12]), _mm_set1_ps(v[3])));
+    _mm_storeu_ps(dst, r);
+}
+
+inline void MathUtil::crossVec3(const float* v1, const float* v2, float* dst)
+{
+    float x = (v1[1] * v2[2]) - (v1[2] * v2[1]);
+    float y = (v1[2] * v2[0]) - (v1[0] * v2[2]);
+    float z = (v1[0] * v2[1]) - (v1[1] * v2[0]);
+
+    dst[0] = x;
+    dst[1] = y;
+    dst[2] = z;
+}
+
+inline void MathUtil::transformVertices(const float* m, float* vertices, size_t count, size_t stride)
+{
+    char* p = (char*)vertices;
+    size_t i = 0;
+
+#if defined(__AVX__)
+    // Each 128 bit lane holds one vertex
+    __m256 c0 = _mm256_broadcast_ps((const __m128*)&m[0]);
+    __m256 c1 = _mm256_broadcast_ps((const __m128*)&m[4]);
+    __m256 c2 = _mm256_broadcast_ps((const __m128*)&m[8]);
+    __m256 c3 = _mm256_broadcast_ps((const __m128*)&m[12]);
+    for (; i + 1 < count; i += 2)
+    {
+        float* v0 = (float*)(p + i * stride);
+        float* v1 = (float*)(p + (i + 1) * stride);
+        __m256 x = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(v0[0])), _mm_set1_ps(v1[0]), 1);
+        __m256 y = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(v0[1])), _mm_set1_ps(v1[1]), 1);
+        __m256 z = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(v0[2])), _mm_set1_ps(v1[2]), 1);
+
+        __m256 r = _mm256_add_ps(_mm256_mul_ps(c0, x), c3);
+        r = _mm256_add_ps(r, _mm256_mul_ps(c1, y));
+        r = _mm256_add_ps(r, _mm256_mul_ps(c2, z));
+
+        __m128 r0 = _mm256_castps256_ps128(r);
+        __m128 r1 = _mm256_extractf128_ps(r, 1);
+        _mm_storel_pi((__m64*)v0, r0);
+        _mm_store_ss(&v0[2], _mm_movehl_ps(r0, r0));
+        _mm_storel_pi((__m64*)v1, r1);
+        _mm_store_ss(&v1[2], _mm_movehl_ps(r1, r1));
+    }
+#endif
+
+    __m128 c0s = _mm_loadu_ps(&m[0]);
+    __m128 c1s = _mm_loadu_ps(&m[4]);
+    __m128 c2s = _mm_loadu_ps(&m[8]);
+    __m128 c3s = _mm_loadu_ps(&m[12]);
+    for (; i < count; ++i)
+    {
+        float* v = (float*)(p + i * stride);
+        __m128 r = _mm_add_ps(_mm_mul_ps(c0s, _mm_set1_ps(v[0])), c3s);
+        r = _mm_add_ps(r, _mm_mul_ps(c1s, _mm_set1_ps(v[1])));
+        r = _mm_add_ps(r, _mm_mul_ps(c2s, _mm_set1_ps(v[2])));
+        _mm_storel_pi((__m64*)v, r);
+        _mm_store_ss(&v[2], _mm_movehl_ps(r, r));
+    }
+}
+
+NS_CC_MATH_END
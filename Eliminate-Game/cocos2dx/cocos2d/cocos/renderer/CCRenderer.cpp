@@ -25,6 +25,7 @@
 #include "renderer/CCRenderer.h"
 
 #include <algorithm>
+#include <cfloat>
 
 #include "renderer/CCQuadCommand.h"
 #include "renderer/CCBatchCommand.h"
@@ -102,6 +103,8 @@ void RenderQueue::clear()
 //
 //
 static const int DEFAULT_RENDER_QUEUE = 0;
+// how many batches a QuadCommand may be moved back past when grouping by material
+static const size_t MAX_QUAD_BATCH_LOOK_BACK = 16;
 
 //
 // constructors, destructors, init
@@ -109,8 +112,18 @@ static const int DEFAULT_RENDER_QUEUE = 0;
 Renderer::Renderer()
 :_lastMaterialID(0)
 ,_lastBatchedMeshCommand(nullptr)
+,_quads(nullptr)
+,_quadCapacity(0)
 ,_numQuads(0)
+,_quadRing(nullptr)
+,_quadRingSection(0)
+,_quadRingOffset(0)
+,_quadRingDisabled(false)
 ,_glViewAssigned(false)
+,_quadReorderEnabled(false)
+,_drawnBatches(0)
+,_drawnVertices(0)
+,_savedBatches(0)
 ,_isRendering(false)
 #if CC_ENABLE_CACHE_TEXTURE_DATA
 ,_cacheTextureListener(nullptr)
@@ -123,6 +136,12 @@ Renderer::Renderer()
     RenderQueue defaultRenderQueue;
     _renderGroups.push_back(defaultRenderQueue);
     _batchedQuadCommands.reserve(BATCH_QUADCOMMAND_RESEVER_SIZE);
+#if CC_RENDERER_PERSISTENT_QUAD_BUFFER
+    for (auto& fence : _quadRingFences)
+    {
+        fence = nullptr;
+    }
+#endif
 }
 
 Renderer::~Renderer()
@@ -130,6 +149,7 @@ Renderer::~Renderer()
     _renderGroups.clear();
     _groupCommandManager->release();
     
+    releaseQuadRing();
     glDeleteBuffers(2, _buffersVBO);
     
     if (Configuration::getInstance()->supportsShareableVAO())
@@ -193,7 +213,7 @@ void Renderer::setupVBOAndVAO()
     glGenBuffers(2, &_buffersVBO[0]);
 
     glBindBuffer(GL_ARRAY_BUFFER, _buffersVBO[0]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(_quads[0]) * VBO_SIZE, _quads, GL_DYNAMIC_DRAW);
+    setupQuadStorage();
 
     // vertices
     glEnableVertexAttribArray(GLProgram::VERTEX_ATTRIB_POSITION);
@@ -231,7 +251,7 @@ void Renderer::mapBuffers()
     GL::bindVAO(0);
 
     glBindBuffer(GL_ARRAY_BUFFER, _buffersVBO[0]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(_quads[0]) * VBO_SIZE, _quads, GL_DYNAMIC_DRAW);
+    setupQuadStorage();
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _buffersVBO[1]);
@@ -241,6 +261,147 @@ void Renderer::mapBuffers()
     CHECK_GL_ERROR_DEBUG();
 }
 
+void Renderer::setupQuadStorage()
+{
+    releaseQuadRing();
+
+#if CC_RENDERER_PERSISTENT_QUAD_BUFFER
+    if (!_quadRingDisabled && Configuration::getInstance()->supportsPersistentBufferMapping())
+    {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        const GLsizeiptr size = sizeof(V3F_C4B_T2F_Quad) * VBO_SIZE * QUAD_RING_SECTIONS;
+        glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+        _quadRing = (V3F_C4B_T2F_Quad*) glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+        if (_quadRing)
+        {
+            _quadStaging.clear();
+            _quadStaging.shrink_to_fit();
+            _quadRingSection = 0;
+            _quadRingOffset = 0;
+            beginQuadBatch();
+            return;
+        }
+
+        // The store of the buffer is immutable once allocated, continue with a new buffer
+        CCLOG("cocos2d: Renderer: could not map the quad buffer persistently, falling back to orphaning");
+        while (glGetError() != GL_NO_ERROR)
+        {
+        }
+        _quadRingDisabled = true;
+        glDeleteBuffers(1, &_buffersVBO[0]);
+        glGenBuffers(1, &_buffersVBO[0]);
+        glBindBuffer(GL_ARRAY_BUFFER, _buffersVBO[0]);
+    }
+#endif
+
+    glBufferData(GL_ARRAY_BUFFER, sizeof(V3F_C4B_T2F_Quad) * VBO_SIZE, nullptr, GL_DYNAMIC_DRAW);
+    _quadStaging.resize(VBO_SIZE);
+    beginQuadBatch();
+}
+
+void Renderer::releaseQuadRing()
+{
+#if CC_RENDERER_PERSISTENT_QUAD_BUFFER
+    for (auto& fence : _quadRingFences)
+    {
+        if (fence)
+        {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+#endif
+    // the mapping goes away with the buffer
+    _quadRing = nullptr;
+}
+
+void Renderer::beginQuadBatch()
+{
+    if (_quadRing)
+    {
+        _quads = _quadRing + _quadRingSection * VBO_SIZE + _quadRingOffset;
+        _quadCapacity = VBO_SIZE - _quadRingOffset;
+    }
+    else
+    {
+        _quads = _quadStaging.data();
+        _quadCapacity = VBO_SIZE;
+    }
+}
+
+void Renderer::nextQuadRingSection()
+{
+#if CC_RENDERER_PERSISTENT_QUAD_BUFFER
+    if (!_quadRing || _quadRingOffset == 0)
+    {
+        return;
+    }
+
+    _quadRingFences[_quadRingSection] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    _quadRingSection = (_quadRingSection + 1) % QUAD_RING_SECTIONS;
+    _quadRingOffset = 0;
+
+    // The GPU must be done with the draws that read this section the last time around.
+    // It rarely lags more than a frame behind, so this seldom blocks.
+    GLsync fence = _quadRingFences[_quadRingSection];
+    if (fence)
+    {
+        GLenum result = glClientWaitSync(fence, 0, 0);
+        while (result == GL_TIMEOUT_EXPIRED)
+        {
+            result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        }
+        glDeleteSync(fence);
+        _quadRingFences[_quadRingSection] = nullptr;
+
+        if (result == GL_WAIT_FAILED)
+        {
+            // Rebuild the buffers without the persistent mapping
+            CCLOG("cocos2d: Renderer: waiting for the quad buffer failed, falling back to orphaning");
+            glFinish();
+            _quadRingDisabled = true;
+            releaseQuadRing();
+            glDeleteBuffers(2, _buffersVBO);
+            if (Configuration::getInstance()->supportsShareableVAO())
+            {
+                glDeleteVertexArrays(1, &_quadVAO);
+                GL::bindVAO(0);
+            }
+            setupBuffer();
+            return;
+        }
+    }
+#endif
+    beginQuadBatch();
+}
+
+void Renderer::fillQuads(const QuadCommand* cmd)
+{
+    V3F_C4B_T2F_Quad* dst = _quads + _numQuads;
+    const V3F_C4B_T2F_Quad* src = cmd->getQuads();
+    ssize_t count = cmd->getQuadCount();
+
+    if (_quadRing)
+    {
+        // Mapped memory is write-combined and slow to read back, so the quads are transformed
+        // in a small buffer that stays in cache and then written out sequentially
+        for (ssize_t i = 0; i < count; i += QUAD_SCRATCH_SIZE)
+        {
+            ssize_t n = count - i < QUAD_SCRATCH_SIZE ? count - i : QUAD_SCRATCH_SIZE;
+            memcpy(_quadScratch, src + i, sizeof(V3F_C4B_T2F_Quad) * n);
+            convertToWorldCoordinates(_quadScratch, n, cmd->getModelView());
+            memcpy(dst + i, _quadScratch, sizeof(V3F_C4B_T2F_Quad) * n);
+        }
+    }
+    else
+    {
+        memcpy(dst, src, sizeof(V3F_C4B_T2F_Quad) * count);
+        convertToWorldCoordinates(dst, count, cmd->getModelView());
+    }
+
+    _numQuads += count;
+}
+
 void Renderer::addCommand(RenderCommand* command)
 {
     int renderQueue =_commandGroupStack.top();
@@ -287,20 +448,23 @@ void Renderer::visitRenderQueue(const RenderQueue& queue)
             flush3D();
             auto cmd = static_cast<QuadCommand*>(command);
             //Batch quads
-            if(_numQuads + cmd->getQuadCount() > VBO_SIZE)
+            if(_numQuads + cmd->getQuadCount() > _quadCapacity)
             {
                 CCASSERT(cmd->getQuadCount()>= 0 && cmd->getQuadCount() < VBO_SIZE, "VBO is not big enough for quad data, please break the quad data down or use customized render command");
                 
                 //Draw batched quads if VBO is full
                 drawBatchedQuads();
+
+                //Continue in the next section when the rest of the mapped one is too small
+                if(cmd->getQuadCount() > _quadCapacity)
+                {
+                    nextQuadRingSection();
+                }
             }
             
             _batchedQuadCommands.push_back(cmd);
             
-            memcpy(_quads + _numQuads, cmd->getQuads(), sizeof(V3F_C4B_T2F_Quad) * cmd->getQuadCount());
-            convertToWorldCoordinates(_quads + _numQuads, cmd->getQuadCount(), cmd->getModelView());
-            
-            _numQuads += cmd->getQuadCount();
+            fillQuads(cmd);
 
         }
         else if(RenderCommand::Type::GROUP_COMMAND == commandType)
@@ -355,16 +519,23 @@ void Renderer::render()
     if (_glViewAssigned)
     {
         // cleanup
-        _drawnBatches = _drawnVertices = 0;
+        _drawnBatches = _drawnVertices = _savedBatches = 0;
 
         //Process render commands
         //1. Sort render commands based on ID
         for (auto &renderqueue : _renderGroups)
         {
             renderqueue.sort();
+            //2. Group quads by material when it does not change the result
+            if (_quadReorderEnabled)
+            {
+                reorderRenderQueue(renderqueue);
+            }
         }
         visitRenderQueue(_renderGroups[0]);
         flush();
+        //Next frame writes to another section while the GPU reads this one
+        nextQuadRingSection();
     }
     clean();
     _isRendering = false;
@@ -391,28 +562,216 @@ void Renderer::clean()
     _lastBatchedMeshCommand = nullptr;
 }
 
-void Renderer::convertToWorldCoordinates(V3F_C4B_T2F_Quad* quads, ssize_t quantity, const Mat4& modelView)
+void Renderer::reorderRenderQueue(RenderQueue& queue)
 {
-//    kmMat4 matrixP, mvp;
-//    kmGLGetMatrix(KM_GL_PROJECTION, &matrixP);
-//    kmMat4Multiply(&mvp, &matrixP, &modelView);
-    for(ssize_t i=0; i<quantity; ++i)
+    reorderQuadCommands(queue._queueNegZ);
+    reorderQuadCommands(queue._queue0);
+    reorderQuadCommands(queue._queuePosZ);
+}
+
+void Renderer::reorderQuadCommands(std::vector<RenderCommand*>& commands)
+{
+    // Only consecutive QuadCommands with the same global Z order are reordered,
+    // any other command is drawn in between and keeps the segments apart
+    size_t size = commands.size();
+    size_t begin = 0;
+    while (begin < size)
+    {
+        if (commands[begin]->getType() != RenderCommand::Type::QUAD_COMMAND)
+        {
+            ++begin;
+            continue;
+        }
+
+        float globalOrder = commands[begin]->getGlobalOrder();
+        size_t end = begin + 1;
+        while (end < size
+               && commands[end]->getType() == RenderCommand::Type::QUAD_COMMAND
+               && commands[end]->getGlobalOrder() == globalOrder)
+        {
+            ++end;
+        }
+
+        // at least three commands are needed to save a batch
+        if (end - begin > 2)
+        {
+            reorderQuadSegment(&commands[begin], end - begin);
+        }
+        begin = end;
+    }
+}
+
+void Renderer::reorderQuadSegment(RenderCommand** commands, size_t count)
+{
+    _quadBatches.clear();
+    _quadBatchLinks.resize(count);
+
+    size_t originalBatches = 0;
+    uint32_t lastMaterialID = QuadCommand::MATERIAL_ID_DO_NOT_BATCH;
+    for (size_t i = 0; i < count; ++i)
+    {
+        auto cmd = static_cast<QuadCommand*>(commands[i]);
+        QuadBatch batch;
+        initQuadBatch(cmd, &batch);
+        batch.head = batch.tail = i;
+        _quadBatchLinks[i] = count;
+
+        // same rule as drawBatchedQuads
+        if (batch.materialID != lastMaterialID || batch.materialID == QuadCommand::MATERIAL_ID_DO_NOT_BATCH)
+        {
+            ++originalBatches;
+        }
+        lastMaterialID = batch.materialID;
+
+        // Join the closest earlier batch with the same material, the command is then drawn
+        // before every batch after it, so all of them must be disjoint from the command
+        bool joined = false;
+        if (batch.materialID != QuadCommand::MATERIAL_ID_DO_NOT_BATCH)
+        {
+            size_t lookBack = 0;
+            for (size_t j = _quadBatches.size(); j > 0 && lookBack < MAX_QUAD_BATCH_LOOK_BACK; --j, ++lookBack)
+            {
+                auto& target = _quadBatches[j - 1];
+                if (target.materialID == batch.materialID)
+                {
+                    _quadBatchLinks[target.tail] = i;
+                    target.tail = i;
+                    mergeQuadBatch(batch, &target);
+                    joined = true;
+                    break;
+                }
+                if (!isQuadBatchDisjoint(target, batch))
+                {
+                    break;
+                }
+            }
+        }
+
+        if (!joined)
+        {
+            _quadBatches.push_back(batch);
+        }
+    }
+
+    // no command was moved
+    if (_quadBatches.size() == originalBatches)
+    {
+        return;
+    }
+
+    _quadBatchCommands.assign(commands, commands + count);
+    size_t index = 0;
+    for (const auto& batch : _quadBatches)
     {
-        V3F_C4B_T2F_Quad *q = &quads[i];
-        Vec3 *vec1 = (Vec3*)&q->bl.vertices;
-        modelView.transformPoint(vec1);
+        for (size_t i = batch.head; i != count; i = _quadBatchLinks[i])
+        {
+            commands[index++] = _quadBatchCommands[i];
+        }
+    }
+    CCASSERT(index == count, "lost commands while reordering");
+
+    _savedBatches += originalBatches - _quadBatches.size();
+}
 
-        Vec3 *vec2 = (Vec3*)&q->br.vertices;
-        modelView.transformPoint(vec2);
+void Renderer::initQuadBatch(const QuadCommand* cmd, QuadBatch* batch)
+{
+    batch->materialID = cmd->getMaterialID();
+    batch->minX = batch->minY = FLT_MAX;
+    batch->maxX = batch->maxY = -FLT_MAX;
+    batch->z = 0;
+    batch->flat = true;
+
+    ssize_t count = cmd->getQuadCount() * 4;
+    if (count <= 0)
+    {
+        return;
+    }
 
-        Vec3 *vec3 = (Vec3*)&q->tr.vertices;
-        modelView.transformPoint(vec3);
+    // bounds in model space
+    const V3F_C4B_T2F* vertices = &cmd->getQuads()->tl;
+    float minX = FLT_MAX, minY = FLT_MAX, minZ = FLT_MAX;
+    float maxX = -FLT_MAX, maxY = -FLT_MAX, maxZ = -FLT_MAX;
+    for (ssize_t i = 0; i < count; ++i)
+    {
+        const Vec3& v = vertices[i].vertices;
+        minX = std::min(minX, v.x);
+        maxX = std::max(maxX, v.x);
+        minY = std::min(minY, v.y);
+        maxY = std::max(maxY, v.y);
+        minZ = std::min(minZ, v.z);
+        maxZ = std::max(maxZ, v.z);
+    }
 
-        Vec3 *vec4 = (Vec3*)&q->tl.vertices;
-        modelView.transformPoint(vec4);
+    // A flat command lies in a plane parallel to the screen. Only then do disjoint bounds
+    // in view space mean the command does not overlap others on screen, even in perspective.
+    Vec3 corners[4] = {
+        Vec3(minX, minY, minZ),
+        Vec3(maxX, minY, minZ),
+        Vec3(minX, maxY, minZ),
+        Vec3(maxX, maxY, minZ),
+    };
+    cmd->getModelView().transformPoints(corners, 4);
+
+    batch->z = corners[0].z;
+    batch->flat = (minZ == maxZ);
+    for (const auto& corner : corners)
+    {
+        batch->minX = std::min(batch->minX, corner.x);
+        batch->maxX = std::max(batch->maxX, corner.x);
+        batch->minY = std::min(batch->minY, corner.y);
+        batch->maxY = std::max(batch->maxY, corner.y);
+        batch->flat = batch->flat && corner.z == batch->z;
     }
 }
 
+void Renderer::mergeQuadBatch(const QuadBatch& from, QuadBatch* to)
+{
+    if (from.minX > from.maxX)
+    {
+        return;
+    }
+
+    if (to->minX > to->maxX)
+    {
+        to->z = from.z;
+        to->flat = from.flat;
+    }
+    else
+    {
+        to->flat = to->flat && from.flat && to->z == from.z;
+    }
+    to->minX = std::min(to->minX, from.minX);
+    to->maxX = std::max(to->maxX, from.maxX);
+    to->minY = std::min(to->minY, from.minY);
+    to->maxY = std::max(to->maxY, from.maxY);
+}
+
+bool Renderer::isQuadBatchDisjoint(const QuadBatch& a, const QuadBatch& b)
+{
+    // empty commands draw nothing
+    if (a.minX > a.maxX || b.minX > b.maxX)
+    {
+        return true;
+    }
+
+    if (!a.flat || !b.flat || a.z != b.z)
+    {
+        return false;
+    }
+
+    // quads that only share an edge do not cover the same pixels
+    return a.maxX <= b.minX || b.maxX <= a.minX || a.maxY <= b.minY || b.maxY <= a.minY;
+}
+
+void Renderer::convertToWorldCoordinates(V3F_C4B_T2F_Quad* quads, ssize_t quantity, const Mat4& modelView)
+{
+//    kmMat4 matrixP, mvp;
+//    kmGLGetMatrix(KM_GL_PROJECTION, &matrixP);
+//    kmMat4Multiply(&mvp, &matrixP, &modelView);
+    // The four vertices of a quad are contiguous, so all of them can be transformed in one pass
+    modelView.transformPoints((Vec3*)&quads->tl.vertices, quantity * 4, sizeof(V3F_C4B_T2F));
+}
+
 void Renderer::drawBatchedQuads()
 {
     //TODO we can improve the draw performance by insert material switching command before hand.
@@ -426,7 +785,27 @@ void Renderer::drawBatchedQuads()
         return;
     }
 
-    if (Configuration::getInstance()->supportsShareableVAO())
+    if (_quadRing)
+    {
+        //The quads are already in the mapped buffer, point the attributes at this batch
+        size_t offset = (_quads - _quadRing) * sizeof(V3F_C4B_T2F_Quad);
+        if (Configuration::getInstance()->supportsShareableVAO())
+        {
+            GL::bindVAO(_quadVAO);
+        }
+        else
+        {
+            GL::enableVertexAttribs(GL::VERTEX_ATTRIB_FLAG_POS_COLOR_TEX);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _buffersVBO[1]);
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, _buffersVBO[0]);
+        glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(V3F_C4B_T2F), (GLvoid*) (offset + offsetof(V3F_C4B_T2F, vertices)));
+        glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(V3F_C4B_T2F), (GLvoid*) (offset + offsetof(V3F_C4B_T2F, colors)));
+        glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_TEX_COORD, 2, GL_FLOAT, GL_FALSE, sizeof(V3F_C4B_T2F), (GLvoid*) (offset + offsetof(V3F_C4B_T2F, texCoords)));
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    else if (Configuration::getInstance()->supportsShareableVAO())
     {
         //Set VBO data
         glBindBuffer(GL_ARRAY_BUFFER, _buffersVBO[0]);
@@ -514,7 +893,12 @@ void Renderer::drawBatchedQuads()
     }
 
     _batchedQuadCommands.clear();
+    if (_quadRing)
+    {
+        _quadRingOffset += _numQuads;
+    }
     _numQuads = 0;
+    beginQuadBatch();
 }
 
 void Renderer::flush()
@@ -34,6 +34,13 @@
 #include "renderer/CCGLProgram.h"
 #include "CCGL.h"
 
+// The persistently mapped quad buffer also needs the GL 4.4 and GL 3.2 entry points in the GL headers
+#if CC_USE_PERSISTENT_QUAD_BUFFER && defined(GL_MAP_PERSISTENT_BIT) && defined(GL_SYNC_GPU_COMMANDS_COMPLETE)
+#define CC_RENDERER_PERSISTENT_QUAD_BUFFER 1
+#else
+#define CC_RENDERER_PERSISTENT_QUAD_BUFFER 0
+#endif
+
 NS_CC_BEGIN
 
 class EventListenerCustom;
@@ -46,6 +53,7 @@ class MeshCommand;
  are the ones that have `z < 0` and `z > 0`.
 */
 class RenderQueue {
+    friend class Renderer;
 
 public:
     void push_back(RenderCommand* command);
@@ -77,6 +85,10 @@ class Renderer
 public:
     static const int VBO_SIZE = 65536 / 6;
     static const int BATCH_QUADCOMMAND_RESEVER_SIZE = 64;
+    // number of VBO_SIZE sections in the persistently mapped quad buffer
+    static const int QUAD_RING_SECTIONS = 3;
+    // quads transformed at a time before they are copied into mapped memory
+    static const int QUAD_SCRATCH_SIZE = 64;
 
     Renderer();
     ~Renderer();
@@ -113,6 +125,16 @@ public:
     ssize_t getDrawnVertices() const { return _drawnVertices; }
     /* RenderCommands (except) QuadCommand should update this value */
     void addDrawnVertices(ssize_t number) { _drawnVertices += number; };
+    /* returns the number of quad batches saved by reordering in the last frame */
+    ssize_t getSavedBatches() const { return _savedBatches; }
+
+    /** Enables or disables grouping `QuadCommand` objects by material before rendering.
+     Within a run of `QuadCommand`s that share the same global Z order, a command is moved
+     back next to an earlier command with the same material when it does not overlap any
+     command it is moved past, so the rendered result does not change. Disabled by default.
+     */
+    void setQuadReorderEnabled(bool enabled) { _quadReorderEnabled = enabled; }
+    bool isQuadReorderEnabled() const { return _quadReorderEnabled; }
 
     inline GroupCommandManager* getGroupCommandManager() const { return _groupCommandManager; };
 
@@ -120,6 +142,18 @@ public:
     bool checkVisibility(const Mat4& transform, const Size& size);
 
 protected:
+    // a group of QuadCommands with the same material after reordering
+    struct QuadBatch
+    {
+        uint32_t materialID;
+        // bounds in view space, commands that are not flat never move past each other
+        float minX, minY, maxX, maxY;
+        float z;
+        bool flat;
+        // commands of the batch, linked through _quadBatchLinks
+        size_t head;
+        size_t tail;
+    };
 
     void setupIndices();
     //Setup VBO or VAO based on OpenGL extensions
@@ -127,6 +161,16 @@ protected:
     void setupVBOAndVAO();
     void setupVBO();
     void mapBuffers();
+    //Allocate the store of the bound vertex buffer, persistently mapped when supported
+    void setupQuadStorage();
+    void releaseQuadRing();
+
+    //Point _quads at the memory the next batch is written to
+    void beginQuadBatch();
+    //Fence the current section of the persistently mapped buffer and move on to the next one
+    void nextQuadRingSection();
+    //Copy the quads of a command into the current batch in world coordinates
+    void fillQuads(const QuadCommand* cmd);
 
     void drawBatchedQuads();
 
@@ -139,6 +183,14 @@ protected:
     
     void visitRenderQueue(const RenderQueue& queue);
 
+    //Group the QuadCommands of a queue by material where the draw order allows it
+    void reorderRenderQueue(RenderQueue& queue);
+    void reorderQuadCommands(std::vector<RenderCommand*>& commands);
+    void reorderQuadSegment(RenderCommand** commands, size_t count);
+    static void initQuadBatch(const QuadCommand* cmd, QuadBatch* batch);
+    static void mergeQuadBatch(const QuadBatch& from, QuadBatch* to);
+    static bool isQuadBatchDisjoint(const QuadBatch& a, const QuadBatch& b);
+
     void convertToWorldCoordinates(V3F_C4B_T2F_Quad* quads, ssize_t quantity, const Mat4& modelView);
 
     std::stack<int> _commandGroupStack;
@@ -150,18 +202,39 @@ protected:
     MeshCommand*              _lastBatchedMeshCommand;
     std::vector<QuadCommand*> _batchedQuadCommands;
 
-    V3F_C4B_T2F_Quad _quads[VBO_SIZE];
+    //Quads of the current batch, points into _quadStaging or into the mapped _quadRing
+    V3F_C4B_T2F_Quad* _quads;
+    //Quads the current batch can hold
+    int _quadCapacity;
+    std::vector<V3F_C4B_T2F_Quad> _quadStaging;
     GLushort _indices[6 * VBO_SIZE];
     GLuint _quadVAO;
     GLuint _buffersVBO[2]; //0: vertex  1: indices
 
     int _numQuads;
+
+    //Persistently mapped vertex buffer of QUAD_RING_SECTIONS * VBO_SIZE quads, nullptr when not used
+    V3F_C4B_T2F_Quad* _quadRing;
+    int _quadRingSection;
+    int _quadRingOffset;
+    bool _quadRingDisabled;
+    V3F_C4B_T2F_Quad _quadScratch[QUAD_SCRATCH_SIZE];
+#if CC_RENDERER_PERSISTENT_QUAD_BUFFER
+    GLsync _quadRingFences[QUAD_RING_SECTIONS];
+#endif
     
     bool _glViewAssigned;
 
+    // material reordering
+    bool _quadReorderEnabled;
+    std::vector<QuadBatch> _quadBatches;
+    std::vector<size_t> _quadBatchLinks;
+    std::vector<RenderCommand*> _quadBatchCommands;
+
     // stats
     ssize_t _drawnBatches;
     ssize_t _drawnVertices;
+    ssize_t _savedBatches;
     //the flag for checking whether renderer is rendering
     bool _isRendering;
     
@@ -0,0 +1,817 @@
+﻿#include "null_gl.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "GL/glew.h"
+
+
+namespace
+{
+	NullGLStats g_stats;
+
+	std::string g_extensions;
+
+	GLuint g_next_name = 1;										// 纹理、缓冲、着色器等对象共用的名字
+	uintptr_t g_next_sync = 1;
+	GLint g_viewport[4] = { 0, 0, 0, 0 };
+	GLuint g_array_buffer = 0;
+	GLuint g_element_buffer = 0;
+	std::unordered_map<GLuint, std::vector<unsigned char>> g_buffers;	// 缓冲内容，映射时返回
+	std::unordered_map<std::string, GLint> g_locations;			// 按名字分配的uniform和attribute位置
+
+	// 生成对象名字
+	void gen_names(GLsizei n, GLuint *names)
+	{
+		++g_stats.calls;
+		for (GLsizei i = 0; i < n; ++i)
+		{
+			names[i] = g_next_name++;
+		}
+	}
+
+	// 绑定到目标的缓冲
+	GLuint& bound_buffer(GLenum target)
+	{
+		return target == GL_ELEMENT_ARRAY_BUFFER ? g_element_buffer : g_array_buffer;
+	}
+
+	// 相同名字总是得到相同位置，着色器的内置uniform因此都有效
+	GLint location_of(const GLchar *name)
+	{
+		auto itr = g_locations.find(name);
+		if (itr != g_locations.end())
+		{
+			return itr->second;
+		}
+		const GLint location = static_cast<GLint>(g_locations.size());
+		g_locations.emplace(name, location);
+		return location;
+	}
+
+	// 每个像素的字节数
+	uint64_t pixel_bytes(GLenum format, GLenum type)
+	{
+		switch (type)
+		{
+		case GL_UNSIGNED_SHORT_4_4_4_4:
+		case GL_UNSIGNED_SHORT_5_5_5_1:
+		case GL_UNSIGNED_SHORT_5_6_5:
+			return 2;
+		default:
+			break;
+		}
+
+		switch (format)
+		{
+		case GL_RGBA:
+			return 4;
+		case GL_RGB:
+			return 3;
+		case GL_LUMINANCE_ALPHA:
+			return 2;
+		default:
+			return 1;
+		}
+	}
+
+	void GLAPIENTRY null_active_texture(GLenum)
+	{
+		++g_stats.calls;
+		++g_stats.state_calls;
+	}
+
+	void GLAPIENTRY null_attach_shader(GLuint, GLuint)
+	{
+		++g_stats.calls;
+	}
+
+	void GLAPIENTRY null_bind_attrib_location(GLuint, GLuint, const GLchar *)
+	{
+		++g_stats.calls;
+	}
+
+	void GLAPIENTRY null_bind_buffer(GLenum target, GLuint buffer)
+	{
+		++g_stats.calls;
+		++g_stats.state_calls;
+		bound_buffer(target) = buffer;
+	}
+
+	void GLAPIENTRY null_bind_framebuffer(GLenum, GLuint)
+	{
+		++g_stats.calls;
+		++g_stats.state_calls;
+	}
+
+	void GLAPIENTRY null_bind_renderbuffer(GLenum, GLuint)
+	{
+		++g_stats.calls;
+	}
+
+	void GLAPIENTRY null_bind_vertex_array(GLuint)
+	{
+		++g_stats.calls;
+		++g_stats.state_calls;
+	}
+
+	void GLAPIENTRY null_blend_equation(GLenum)
+	{
+		++g_stats.calls;
+		++g_stats.state_calls;
+	}
+
+	void GLAPIENTRY null_blend_func_separate(GLenum, GLenum, GLenum, GLenum)
+	{
+		++g_stats.calls;
+		++g_stats.state_calls;
+	}
+
+	void GLAPIENTRY null_buffer_data(GLenum target, GLsizeiptr size, const GLvoid *data, GLenum)
+	{
+		++g_stats.calls;
+		g_stats.buffer_bytes += data != nullptr ? size : 0;
+		g_buffers[bound_buffer(target)].resize(size);
+	}
+
+	void GLAPIENTRY null_buffer_sub_data(GLenum, GLintptr, GLsizeiptr size, const GLvoid *)
+	{
+		++g_stats.calls;
+		g_stats.buffer_bytes += size;
+	}
+
+	GLenum GLAPIENTRY null_check_framebuffer_status(GLenum)
+	{
+		++g_stats.calls;
+		return GL_FRAMEBUFFER_COMPLETE;
+	}
+
+	void GLAPIENTRY null_compile_shader(GLuint)
+	{
+		++g_stats.calls;
+	}
+
+	void GLAPIENTRY null_compressed_tex_image_2d(GLenum, GLint, GLenum, GLsizei, GLsizei, GLint, GLsizei image_size, const GLvoid *)
+	{
+		++g_stats.calls;
+		g_stats.texture_bytes += image_size;
+	}
+
+	GLuint GLAPIENTRY null_create_object()
+	{
+		++g_stats.calls;
+		return g_next_name++;
+	}
+
+	GLuint GLAPIENTRY null_create_shader(GLenum)
+	{
+		return null_create_object();
+	}
+
+	void GLAPIENTRY null_delete_buffers(GLsizei n, const GLuint *buffers)
+	{
+		++g_stats.calls;
+		for (GLsizei i = 0; i < n; ++i)
+		{
+			g_buffers.erase(buffers[i]);
+		}
+	}
+
+	void GLAPIENTRY null_delete_names(GLsizei, const GLuint *)
+	{
+		++g_stats.calls;
+	}
+
+	void GLAPIENTRY null_delete_object(GLuint)
+	{
+		++g_stats.calls;
+	}
+
+	void GLAPIENTRY null_vertex_attrib_array(GLuint)
+	{
+		++g_stats.calls;
+		++g_stats.state_calls;
+	}
+
+	void GLAPIENTRY null_framebuffer_renderbuffer(GLenum, GLenum, GLenum, GLuint)
+	{
+		++g_stats.calls;
+	}
+
+	void GLAPIENTRY null_framebuffer_texture_2d(GLenum, GLenum, GLenum, GLuint, GLint)
+	{
+		++g_stats.calls;
+	}
+
+	void GLAPIENTRY null_gen_names(GLsizei n, GLuint *names)
+	{
+		gen_names(n, names);
+	}
+
+	void GLAPIENTRY null_generate_mipmap(GLenum)
+	{
+		++g_stats.calls;
+	}
+
+	void GLAPIENTRY null_get_active(GLuint, GLuint, GLsizei max_length, GLsizei *length, GLint *, GLenum *, GLchar *name)
+	{
+		++g_stats.calls;
+		if (length != nullptr)
+		{
+			*length = 0;
+		}
+		if (max_length > 0)
+		{
+			name[0] = '\0';
+		}
+	}
+
+	GLint GLAPIENTRY null_get_location(GLuint, const GLchar *name)
+	{
+		++g_stats.calls;
+		return location_of(name);
+	}
+
+	void GLAPIENTRY null_get_info_log(GLuint, GLsizei buf_size, GLsizei *length, GLchar *info_log)
+	{
+		++g_stats.calls;
+		if (length != nullptr)
+		{
+			*length = 0;
+		}
+		if (buf_size > 0)
+		{
+			info_log[0] = '\0';
+		}
+	}
+
+	// 编译和链接总是成功，没有活动的attribute和uniform
+	void GLAPIENTRY null_get_object_iv(GLuint, GLenum pname, GLint *param)
+	{
+		++g_stats.calls;
+		*param = (pname == GL_COMPILE_STATUS || pname == GL_LINK_STATUS) ? GL_TRUE : 0;
+	}
+
+	GLboolean GLAPIENTRY null_is_buffer(GLuint buffer)
+	{
+		++g_stats.calls;
+		return g_buffers.count(buffer) > 0 ? GL_TRUE : GL_FALSE;
+	}
+
+	void GLAPIENTRY null_link_program(GLuint)
+	{
+		++g_stats.calls;
+	}
+
+	// 映射返回保存的缓冲内存，实际写入的字节无法区分，按映射大小计入
+	GLvoid* GLAPIENTRY null_map_buffer(GLenum target, GLenum)
+	{
+		++g_stats.calls;
+		std::vector<unsigned char> &data = g_buffers[bound_buffer(target)];
+		g_stats.buffer_bytes += data.size();
+		return data.empty() ? nullptr : data.data();
+	}
+
+	GLvoid* GLAPIENTRY null_map_buffer_range(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access)
+	{
+		++g_stats.calls;
+		std::vector<unsigned char> &data = g_buffers[bound_buffer(target)];
+		if (offset + length > static_cast<GLintptr>(data.size()))
+		{
+			return nullptr;
+		}
+		if ((access & GL_MAP_WRITE_BIT) != 0)
+		{
+			g_stats.buffer_bytes += length;
+		}
+		return data.data() + offset;
+	}
+
+	void GLAPIENTRY null_flush_mapped_buffer_range(GLenum, GLintptr, GLsizeiptr)
+	{
+		++g_stats.calls;
+	}
+
+	void GLAPIENTRY null_renderbuffer_storage(GLenum, GLenum, GLsizei, GLsizei)
+	{
+		++g_stats.calls;
+	}
+
+	void GLAPIENTRY null_shader_source(GLuint, GLsizei, const GLchar *const *, const GLint *)
+	{
+		++g_stats.calls;
+	}
+
+	void GLAPIENTRY null_uniform_1f(GLint, GLfloat)
+	{
+		++g_stats.calls;
+		++g_stats.uniform_calls;
+	}
+
+	void GLAPIENTRY null_uniform_2f(GLint, GLfloat, GLfloat)
+	{
+		++g_stats.calls;
+		++g_stats.uniform_calls;
+	}
+
+	void GLAPIENTRY null_uniform_3f(GLint, GLfloat, GLfloat, GLfloat)
+	{
+		++g_stats.calls;
+		++g_stats.uniform_calls;
+	}
+
+	void GLAPIENTRY null_uniform_4f(GLint, GLfloat, GLfloat, GLfloat, GLfloat)
+	{
+		++g_stats.calls;
+		++g_stats.uniform_calls;
+	}
+
+	void GLAPIENTRY null_uniform_1i(GLint, GLint)
+	{
+		++g_stats.calls;
+		++g_stats.uniform_calls;
+	}
+
+	void GLAPIENTRY null_uniform_2i(GLint, GLint, GLint)
+	{
+		++g_stats.calls;
+		++g_stats.uniform_calls;
+	}
+
+	void GLAPIENTRY null_uniform_3i(GLint, GLint, GLint, GLint)
+	{
+		++g_stats.calls;
+		++g_stats.uniform_calls;
+	}
+
+	void GLAPIENTRY null_uniform_4i(GLint, GLint, GLint, GLint, GLint)
+	{
+		++g_stats.calls;
+		++g_stats.uniform_calls;
+	}
+
+	void GLAPIENTRY null_uniform_fv(GLint, GLsizei, const GLfloat *)
+	{
+		++g_stats.calls;
+		++g_stats.uniform_calls;
+	}
+
+	void GLAPIENTRY null_uniform_iv(GLint, GLsizei, const GLint *)
+	{
+		++g_stats.calls;
+		++g_stats.uniform_calls;
+	}
+
+	void GLAPIENTRY null_uniform_matrix_fv(GLint, GLsizei, GLboolean, const GLfloat *)
+	{
+		++g_stats.calls;
+		++g_stats.uniform_calls;
+	}
+
+	GLboolean GLAPIENTRY null_unmap_buffer(GLenum)
+	{
+		++g_stats.calls;
+		return GL_TRUE;
+	}
+
+	void GLAPIENTRY null_use_program(GLuint)
+	{
+		++g_stats.calls;
+		++g_stats.program_binds;
+	}
+
+	void GLAPIENTRY null_vertex_attrib_pointer(GLuint, GLint, GLenum, GLboolean, GLsizei, const GLvoid *)
+	{
+		++g_stats.calls;
+		++g_stats.state_calls;
+	}
+
+#if defined(GL_ARB_sync)
+	GLsync GLAPIENTRY null_fence_sync(GLenum, GLbitfield)
+	{
+		++g_stats.calls;
+		return reinterpret_cast<GLsync>(g_next_sync++);
+	}
+
+	GLenum GLAPIENTRY null_client_wait_sync(GLsync, GLbitfield, GLuint64)
+	{
+		++g_stats.calls;
+		return GL_ALREADY_SIGNALED;
+	}
+
+	void GLAPIENTRY null_delete_sync(GLsync)
+	{
+		++g_stats.calls;
+	}
+#endif
+
+#if defined(GL_ARB_buffer_storage)
+	void GLAPIENTRY null_buffer_storage(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags)
+	{
+		++g_stats.calls;
+		g_stats.buffer_bytes += data != nullptr ? size : 0;
+		g_buffers[bound_buffer(target)].resize(size);
+	}
+#endif
+}
+
+// OpenGL 1.1的函数由libGL直接导出，在可执行文件中定义同名函数即可替换
+extern "C"
+{
+	void GLAPIENTRY glAlphaFunc(GLenum, GLclampf)
+	{
+		++g_stats.calls;
+	}
+
+	void GLAPIENTRY glBindTexture(GLenum, GLuint)
+	{
+		++g_stats.calls;
+		++g_stats.texture_binds;
+	}
+
+	void GLAPIENTRY glBlendFunc(GLenum, GLenum)
+	{
+		++g_stats.calls;
+		++g_stats.state_calls;
+	}
+
+	void GLAPIENTRY glClear(GLbitfield)
+	{
+		++g_stats.calls;
+	}
+
+	void GLAPIENTRY glClearColor(GLclampf, GLclampf, GLclampf, GLclampf)
+	{
+		++g_stats.calls;
+	}
+
+	void GLAPIENTRY glClearDepth(GLclampd)
+	{
+		++g_stats.calls;
+	}
+
+	void GLAPIENTRY glClearStencil(GLint)
+	{
+		++g_stats.calls;
+	}
+
+	void GLAPIENTRY glColorMask(GLboolean, GLboolean, GLboolean, GLboolean)
+	{
+		++g_stats.calls;
+		++g_stats.state_calls;
+	}
+
+	void GLAPIENTRY glCullFace(GLenum)
+	{
+		++g_stats.calls;
+		++g_stats.state_calls;
+	}
+
+	void GLAPIENTRY glDeleteTextures(GLsizei, const GLuint *)
+	{
+		++g_stats.calls;
+	}
+
+	void GLAPIENTRY glDepthFunc(GLenum)
+	{
+		++g_stats.calls;
+		++g_stats.state_calls;
+	}
+
+	void GLAPIENTRY glDepthMask(GLboolean)
+	{
+		++g_stats.calls;
+		++g_stats.state_calls;
+	}
+
+	void GLAPIENTRY glDepthRange(GLclampd, GLclampd)
+	{
+		++g_stats.calls;
+	}
+
+	void GLAPIENTRY glDisable(GLenum)
+	{
+		++g_stats.calls;
+		++g_stats.state_calls;
+	}
+
+	void GLAPIENTRY glDisableClientState(GLenum)
+	{
+		++g_stats.calls;
+	}
+
+	void GLAPIENTRY glDrawArrays(GLenum, GLint, GLsizei count)
+	{
+		++g_stats.calls;
+		++g_stats.draw_calls;
+		g_stats.vertices += count;
+	}
+
+	void GLAPIENTRY glDrawElements(GLenum, GLsizei count, GLenum, const GLvoid *)
+	{
+		++g_stats.calls;
+		++g_stats.draw_calls;
+		g_stats.vertices += count;
+	}
+
+	void GLAPIENTRY glEnable(GLenum)
+	{
+		++g_stats.calls;
+		++g_stats.state_calls;
+	}
+
+	void GLAPIENTRY glEnableClientState(GLenum)
+	{
+		++g_stats.calls;
+	}
+
+	void GLAPIENTRY glFinish(void)
+	{
+		++g_stats.calls;
+	}
+
+	void GLAPIENTRY glFlush(void)
+	{
+		++g_stats.calls;
+	}
+
+	void GLAPIENTRY glFrontFace(GLenum)
+	{
+		++g_stats.calls;
+		++g_stats.state_calls;
+	}
+
+	void GLAPIENTRY glGenTextures(GLsizei n, GLuint *textures)
+	{
+		gen_names(n, textures);
+	}
+
+	void GLAPIENTRY glGetBooleanv(GLenum, GLboolean *params)
+	{
+		++g_stats.calls;
+		params[0] = GL_FALSE;
+	}
+
+	GLenum GLAPIENTRY glGetError(void)
+	{
+		++g_stats.calls;
+		return GL_NO_ERROR;
+	}
+
+	void GLAPIENTRY glGetFloatv(GLenum, GLfloat *params)
+	{
+		++g_stats.calls;
+		params[0] = 0.0f;
+	}
+
+	void GLAPIENTRY glGetIntegerv(GLenum pname, GLint *params)
+	{
+		++g_stats.calls;
+		switch (pname)
+		{
+		case GL_VIEWPORT:
+			params[0] = g_viewport[0];
+			params[1] = g_viewport[1];
+			params[2] = g_viewport[2];
+			params[3] = g_viewport[3];
+			break;
+		case GL_MAX_TEXTURE_SIZE:
+			params[0] = 8192;
+			break;
+		case GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS:
+		case GL_MAX_VERTEX_ATTRIBS:
+			params[0] = 16;
+			break;
+		case GL_ARRAY_BUFFER_BINDING:
+			params[0] = g_array_buffer;
+			break;
+		case GL_ELEMENT_ARRAY_BUFFER_BINDING:
+			params[0] = g_element_buffer;
+			break;
+		default:
+			params[0] = 0;
+			break;
+		}
+	}
+
+	const GLubyte* GLAPIENTRY glGetString(GLenum name)
+	{
+		++g_stats.calls;
+		switch (name)
+		{
+		case GL_VENDOR:
+			return reinterpret_cast<const GLubyte *>("null");
+		case GL_RENDERER:
+			return reinterpret_cast<const GLubyte *>("null renderer");
+		case GL_VERSION:
+			return reinterpret_cast<const GLubyte *>("2.1 null");
+		case GL_SHADING_LANGUAGE_VERSION:
+			return reinterpret_cast<const GLubyte *>("1.20");
+		case GL_EXTENSIONS:
+			return reinterpret_cast<const GLubyte *>(g_extensions.c_str());
+		default:
+			return nullptr;
+		}
+	}
+
+	void GLAPIENTRY glHint(GLenum, GLenum)
+	{
+		++g_stats.calls;
+	}
+
+	GLboolean GLAPIENTRY glIsEnabled(GLenum)
+	{
+		++g_stats.calls;
+		return GL_FALSE;
+	}
+
+	void GLAPIENTRY glLineWidth(GLfloat)
+	{
+		++g_stats.calls;
+		++g_stats.state_calls;
+	}
+
+	void GLAPIENTRY glPixelStorei(GLenum, GLint)
+	{
+		++g_stats.calls;
+	}
+
+	void GLAPIENTRY glPointSize(GLfloat)
+	{
+		++g_stats.calls;
+	}
+
+	void GLAPIENTRY glPolygonOffset(GLfloat, GLfloat)
+	{
+		++g_stats.calls;
+	}
+
+	void GLAPIENTRY glReadPixels(GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, GLvoid *)
+	{
+		++g_stats.calls;
+	}
+
+	void GLAPIENTRY glScissor(GLint, GLint, GLsizei, GLsizei)
+	{
+		++g_stats.calls;
+		++g_stats.state_calls;
+	}
+
+	void GLAPIENTRY glStencilFunc(GLenum, GLint, GLuint)
+	{
+		++g_stats.calls;
+		++g_stats.state_calls;
+	}
+
+	void GLAPIENTRY glStencilMask(GLuint)
+	{
+		++g_stats.calls;
+		++g_stats.state_calls;
+	}
+
+	void GLAPIENTRY glStencilOp(GLenum, GLenum, GLenum)
+	{
+		++g_stats.calls;
+		++g_stats.state_calls;
+	}
+
+	void GLAPIENTRY glTexImage2D(GLenum, GLint, GLint, GLsizei width, GLsizei height, GLint, GLenum format, GLenum type, const GLvoid *pixels)
+	{
+		++g_stats.calls;
+		g_stats.texture_bytes += pixels != nullptr ? width * height * pixel_bytes(format, type) : 0;
+	}
+
+	void GLAPIENTRY glTexParameteri(GLenum, GLenum, GLint)
+	{
+		++g_stats.calls;
+	}
+
+	void GLAPIENTRY glTexSubImage2D(GLenum, GLint, GLint, GLint, GLsizei width, GLsizei height, GLenum format, GLenum type, const GLvoid *)
+	{
+		++g_stats.calls;
+		g_stats.texture_bytes += width * height * pixel_bytes(format, type);
+	}
+
+	void GLAPIENTRY glViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+	{
+		++g_stats.calls;
+		++g_stats.state_calls;
+		g_viewport[0] = x;
+		g_viewport[1] = y;
+		g_viewport[2] = width;
+		g_viewport[3] = height;
+	}
+}
+
+// 安装空GL后端
+// 引擎只使用这里替换的函数，其余GLEW函数指针保持为空
+void null_gl_install(bool persistent_mapping)
+{
+	// Configuration按名字检查扩展，桌面渲染器使用VAO
+	g_extensions = "GL_ARB_vertex_array_object GL_ARB_framebuffer_object";
+	if (persistent_mapping)
+	{
+		g_extensions += " GL_ARB_buffer_storage GL_ARB_sync";
+	}
+
+	__glewActiveTexture = null_active_texture;
+	__glewAttachShader = null_attach_shader;
+	__glewBindAttribLocation = null_bind_attrib_location;
+	__glewBindBuffer = null_bind_buffer;
+	__glewBindFramebuffer = null_bind_framebuffer;
+	__glewBindRenderbuffer = null_bind_renderbuffer;
+	__glewBindVertexArray = null_bind_vertex_array;
+	__glewBlendEquation = null_blend_equation;
+	__glewBlendFuncSeparate = null_blend_func_separate;
+	__glewBufferData = null_buffer_data;
+	__glewBufferSubData = null_buffer_sub_data;
+	__glewCheckFramebufferStatus = null_check_framebuffer_status;
+	__glewCompileShader = null_compile_shader;
+	__glewCompressedTexImage2D = null_compressed_tex_image_2d;
+	__glewCreateProgram = null_create_object;
+	__glewCreateShader = null_create_shader;
+	__glewDeleteBuffers = null_delete_buffers;
+	__glewDeleteFramebuffers = null_delete_names;
+	__glewDeleteProgram = null_delete_object;
+	__glewDeleteRenderbuffers = null_delete_names;
+	__glewDeleteShader = null_delete_object;
+	__glewDeleteVertexArrays = null_delete_names;
+	__glewDisableVertexAttribArray = null_vertex_attrib_array;
+	__glewEnableVertexAttribArray = null_vertex_attrib_array;
+	__glewFramebufferRenderbuffer = null_framebuffer_renderbuffer;
+	__glewFramebufferTexture2D = null_framebuffer_texture_2d;
+	__glewGenBuffers = null_gen_names;
+	__glewGenFramebuffers = null_gen_names;
+	__glewGenRenderbuffers = null_gen_names;
+	__glewGenVertexArrays = null_gen_names;
+	__glewGenerateMipmap = null_generate_mipmap;
+	__glewGetActiveAttrib = null_get_active;
+	__glewGetActiveUniform = null_get_active;
+	__glewGetAttribLocation = null_get_location;
+	__glewGetProgramInfoLog = null_get_info_log;
+	__glewGetProgramiv = null_get_object_iv;
+	__glewGetShaderInfoLog = null_get_info_log;
+	__glewGetShaderSource = null_get_info_log;
+	__glewGetShaderiv = null_get_object_iv;
+	__glewGetUniformLocation = null_get_location;
+	__glewIsBuffer = null_is_buffer;
+	__glewLinkProgram = null_link_program;
+	__glewMapBuffer = null_map_buffer;
+	__glewMapBufferRange = null_map_buffer_range;
+	__glewFlushMappedBufferRange = null_flush_mapped_buffer_range;
+	__glewRenderbufferStorage = null_renderbuffer_storage;
+	// 不同版本的GLEW中字符串参数的const不同
+	__glewShaderSource = reinterpret_cast<PFNGLSHADERSOURCEPROC>(null_shader_source);
+	__glewUniform1f = null_uniform_1f;
+	__glewUniform2f = null_uniform_2f;
+	__glewUniform3f = null_uniform_3f;
+	__glewUniform4f = null_uniform_4f;
+	__glewUniform1i = null_uniform_1i;
+	__glewUniform2i = null_uniform_2i;
+	__glewUniform3i = null_uniform_3i;
+	__glewUniform4i = null_uniform_4i;
+	__glewUniform1fv = null_uniform_fv;
+	__glewUniform2fv = null_uniform_fv;
+	__glewUniform3fv = null_uniform_fv;
+	__glewUniform4fv = null_uniform_fv;
+	__glewUniform1iv = null_uniform_iv;
+	__glewUniform2iv = null_uniform_iv;
+	__glewUniform3iv = null_uniform_iv;
+	__glewUniform4iv = null_uniform_iv;
+	__glewUniformMatrix2fv = null_uniform_matrix_fv;
+	__glewUniformMatrix3fv = null_uniform_matrix_fv;
+	__glewUniformMatrix4fv = null_uniform_matrix_fv;
+	__glewUnmapBuffer = null_unmap_buffer;
+	__glewUseProgram = null_use_program;
+	__glewVertexAttribPointer = null_vertex_attrib_pointer;
+#if defined(GL_ARB_sync)
+	__glewFenceSync = null_fence_sync;
+	__glewClientWaitSync = null_client_wait_sync;
+	__glewDeleteSync = null_delete_sync;
+#endif
+#if defined(GL_ARB_buffer_storage)
+	__glewBufferStorage = null_buffer_storage;
+#endif
+}
+
+// 当前统计
+const NullGLStats& null_gl_stats()
+{
+	return g_stats;
+}
+
+// 两次统计之差
+NullGLStats null_gl_diff(const NullGLStats &after, const NullGLStats &before)
+{
+	NullGLStats ret;
+	ret.calls = after.calls - before.calls;
+	ret.draw_calls = after.draw_calls - before.draw_calls;
+	ret.vertices = after.vertices - before.vertices;
+	ret.buffer_bytes = after.buffer_bytes - before.buffer_bytes;
+	ret.texture_bytes = after.texture_bytes - before.texture_bytes;
+	ret.program_binds = after.program_binds - before.program_binds;
+	ret.texture_binds = after.texture_binds - before.texture_binds;
+	ret.uniform_calls = after.uniform_calls - before.uniform_calls;
+	ret.state_calls = after.state_calls - before.state_calls;
+	return ret;
+}
@@ -0,0 +1,59 @@
+﻿/**
+ * 空GL后端
+ * 不需要显卡和窗口，GL调用只做计数，用于在构建机上测量渲染器的CPU开销
+ * OpenGL 1.1的函数直接在可执行文件中定义，覆盖libGL的同名函数
+ * 其余函数通过GLEW的函数指针调用，安装时替换为计数函数，不调用glewInit
+ */
+
+#ifndef __NULL_GL_H__
+#define __NULL_GL_H__
+
+#include <cstdint>
+
+/**
+ * GL调用统计
+ */
+struct NullGLStats
+{
+	uint64_t	calls;			// 所有GL调用
+	uint64_t	draw_calls;		// glDrawArrays和glDrawElements
+	uint64_t	vertices;		// 绘制的顶点或索引数量
+	uint64_t	buffer_bytes;	// 上传到缓冲的字节数
+	uint64_t	texture_bytes;	// 上传到纹理的字节数
+	uint64_t	program_binds;	// glUseProgram
+	uint64_t	texture_binds;	// glBindTexture
+	uint64_t	uniform_calls;	// glUniform*
+	uint64_t	state_calls;	// 开关、混合、缓冲绑定等状态设置
+
+	NullGLStats()
+		: calls(0)
+		, draw_calls(0)
+		, vertices(0)
+		, buffer_bytes(0)
+		, texture_bytes(0)
+		, program_binds(0)
+		, texture_binds(0)
+		, uniform_calls(0)
+		, state_calls(0)
+	{
+	}
+};
+
+/**
+ * 安装空GL后端
+ * 必须在引擎调用任何GL函数之前执行
+ * @param persistent_mapping 是否声明支持常驻映射缓冲，声明后渲染器使用环形缓冲，写入映射内存的字节不计入统计
+ */
+void null_gl_install(bool persistent_mapping);
+
+/**
+ * 当前统计
+ */
+const NullGLStats& null_gl_stats();
+
+/**
+ * 两次统计之差
+ */
+NullGLStats null_gl_diff(const NullGLStats &after, const NullGLStats &before);
+
+#endif
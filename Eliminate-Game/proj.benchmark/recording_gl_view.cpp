@@ -0,0 +1,51 @@
+﻿#include "recording_gl_view.h"
+using namespace cocos2d;
+
+
+RecordingGLView::RecordingGLView()
+	: frames_(0)
+{
+}
+
+// 创建
+RecordingGLView* RecordingGLView::create(const Size &frame_size, bool persistent_mapping)
+{
+	// 基类构造时没有窗口，引擎在设置视图之后才调用GL
+	null_gl_install(persistent_mapping);
+
+	auto ret = new RecordingGLView();
+	ret->setFrameSize(frame_size.width, frame_size.height);
+	ret->autorelease();
+	return ret;
+}
+
+// 没有上下文，总是可以绘制
+bool RecordingGLView::isOpenGLReady()
+{
+	return true;
+}
+
+// 交换缓冲
+void RecordingGLView::swapBuffers()
+{
+	++frames_;
+}
+
+// 设置帧大小
+// 不调整窗口
+void RecordingGLView::setFrameSize(float width, float height)
+{
+	GLViewProtocol::setFrameSize(width, height);
+}
+
+// 已交换的帧数
+uint64_t RecordingGLView::get_frames() const
+{
+	return frames_;
+}
+
+// GL调用统计
+const NullGLStats& RecordingGLView::get_stats() const
+{
+	return null_gl_stats();
+}
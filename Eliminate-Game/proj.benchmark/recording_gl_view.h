@@ -0,0 +1,48 @@
+﻿/**
+ * 记录用GLView
+ * 没有窗口和GL上下文，安装空GL后端，交换缓冲时只记录帧数
+ * 引擎的GL调用都计入空GL后端的统计
+ */
+
+#ifndef __RECORDING_GL_VIEW_H__
+#define __RECORDING_GL_VIEW_H__
+
+#include <cstdint>
+#include "cocos2d.h"
+#include "null_gl.h"
+
+class RecordingGLView : public cocos2d::GLView
+{
+public:
+	/**
+	 * 创建
+	 * @param persistent_mapping 是否声明支持常驻映射缓冲
+	 */
+	static RecordingGLView* create(const cocos2d::Size &frame_size, bool persistent_mapping);
+
+public:
+	virtual bool isOpenGLReady() override;
+
+	virtual void swapBuffers() override;
+
+	virtual void setFrameSize(float width, float height) override;
+
+public:
+	/**
+	 * 已交换的帧数
+	 */
+	uint64_t get_frames() const;
+
+	/**
+	 * GL调用统计
+	 */
+	const NullGLStats& get_stats() const;
+
+protected:
+	RecordingGLView();
+
+private:
+	uint64_t			frames_;
+};
+
+#endif
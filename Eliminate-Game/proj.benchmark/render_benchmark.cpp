@@ -0,0 +1,368 @@
+﻿/**
+ * 渲染器CPU开销测试
+ * 在空GL后端上用Director::drawScene绘制大量精灵的合成场景，统计每帧耗时与GL调用
+ * 不需要显卡和窗口，遍历、排序、合批、顶点变换和着色器状态设置都照常执行
+ */
+
+#include <chrono>
+#include <random>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include "cocos2d.h"
+#include "StaticBatch.h"
+#include "null_gl.h"
+#include "recording_gl_view.h"
+using namespace cocos2d;
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	const float kWidth = 960.0f;
+	const float kHeight = 640.0f;
+	const int kTextureSize = 32;
+
+	/**
+	 * 引擎需要应用实例，测试不进入主循环
+	 */
+	class BenchmarkApp : public Application
+	{
+	public:
+		virtual bool applicationDidFinishLaunching() override
+		{
+			return true;
+		}
+
+		virtual void applicationDidEnterBackground() override
+		{
+		}
+
+		virtual void applicationWillEnterForeground() override
+		{
+		}
+	};
+
+	struct Options
+	{
+		std::vector<int>	sprite_nums;	// 每个场景的精灵数量
+		int					frames;			// 每个场景统计的帧数
+		int					warmup;			// 每个场景预热的帧数
+		int					textures;		// 纹理数量，精灵依次使用
+		bool				static_batch;	// 精灵放在StaticBatch下
+		bool				moving;			// 每帧移动所有精灵
+		bool				persistent;		// 声明支持常驻映射缓冲
+		bool				reorder;		// 按材质重排四边形命令
+		unsigned			seed;			// 随机种子
+
+		Options()
+			: frames(300)
+			, warmup(10)
+			, textures(1)
+			, static_batch(false)
+			, moving(false)
+			, persistent(false)
+			, reorder(true)
+			, seed(1)
+		{
+			sprite_nums.push_back(1000);
+			sprite_nums.push_back(5000);
+			sprite_nums.push_back(10000);
+			sprite_nums.push_back(50000);
+			sprite_nums.push_back(100000);
+		}
+	};
+
+	/**
+	 * 单帧的时间点，由Director的事件记录
+	 */
+	struct FrameTimes
+	{
+		Clock::time_point	after_visit;
+		Clock::time_point	after_draw;
+	};
+
+	void print_usage(const char *name)
+	{
+		printf("usage: %s [--sprites N,N,...] [--frames N] [--warmup N] [--textures N] [--static] [--moving] [--persistent] [--no-reorder] [--seed N]\n", name);
+	}
+
+	// 解析逗号分隔的数量
+	bool parse_sprite_nums(const char *arg, std::vector<int> &ret)
+	{
+		ret.clear();
+		const char *itr = arg;
+		while (*itr != '\0')
+		{
+			char *end = nullptr;
+			const long num = strtol(itr, &end, 10);
+			if (end == itr || num <= 0)
+			{
+				return false;
+			}
+			ret.push_back(static_cast<int>(num));
+			itr = *end == ',' ? end + 1 : end;
+		}
+		return !ret.empty();
+	}
+
+	bool parse_options(int argc, char **argv, Options &options)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			const char *arg = argv[i];
+			if (strcmp(arg, "--sprites") == 0 && i + 1 < argc)
+			{
+				if (!parse_sprite_nums(argv[++i], options.sprite_nums))
+				{
+					return false;
+				}
+			}
+			else if (strcmp(arg, "--frames") == 0 && i + 1 < argc)
+			{
+				options.frames = atoi(argv[++i]);
+			}
+			else if (strcmp(arg, "--warmup") == 0 && i + 1 < argc)
+			{
+				options.warmup = atoi(argv[++i]);
+			}
+			else if (strcmp(arg, "--textures") == 0 && i + 1 < argc)
+			{
+				options.textures = atoi(argv[++i]);
+			}
+			else if (strcmp(arg, "--static") == 0)
+			{
+				options.static_batch = true;
+			}
+			else if (strcmp(arg, "--moving") == 0)
+			{
+				options.moving = true;
+			}
+			else if (strcmp(arg, "--persistent") == 0)
+			{
+				options.persistent = true;
+			}
+			else if (strcmp(arg, "--no-reorder") == 0)
+			{
+				options.reorder = false;
+			}
+			else if (strcmp(arg, "--seed") == 0 && i + 1 < argc)
+			{
+				options.seed = static_cast<unsigned>(strtoul(argv[++i], nullptr, 10));
+			}
+			else
+			{
+				return false;
+			}
+		}
+
+		return options.frames > 0
+			&& options.warmup >= 0
+			&& options.textures > 0;
+	}
+
+	// 创建纯色纹理，由调用者释放
+	Texture2D* create_texture(int index)
+	{
+		std::vector<unsigned char> pixels(kTextureSize * kTextureSize * 4, static_cast<unsigned char>(64 + index * 37));
+		auto texture = new Texture2D();
+		texture->initWithData(pixels.data(), pixels.size(), Texture2D::PixelFormat::RGBA8888, kTextureSize, kTextureSize, Size(kTextureSize, kTextureSize));
+		return texture;
+	}
+
+	// 随机摆放精灵的场景
+	Scene* create_scene(const Options &options, int sprite_num, const std::vector<Texture2D *> &textures, std::mt19937 &rng, std::vector<Sprite *> &sprites)
+	{
+		std::uniform_real_distribution<float> x_dis(0.0f, kWidth);
+		std::uniform_real_distribution<float> y_dis(0.0f, kHeight);
+
+		auto scene = Scene::create();
+		Node *root = options.static_batch ? static_cast<Node *>(StaticBatch::create()) : Node::create();
+		scene->addChild(root);
+
+		sprites.clear();
+		sprites.reserve(sprite_num);
+		for (int i = 0; i < sprite_num; ++i)
+		{
+			auto sprite = Sprite::createWithTexture(textures[i % textures.size()]);
+			sprite->setPosition(Vec2(x_dis(rng), y_dis(rng)));
+			root->addChild(sprite);
+			sprites.push_back(sprite);
+		}
+		return scene;
+	}
+
+	// 来回移动精灵，每帧矩阵都需要重新计算
+	void move_sprites(const std::vector<Sprite *> &sprites, uint64_t frame)
+	{
+		const float offset = (frame % 2 == 0) ? 1.0f : -1.0f;
+		for (auto sprite : sprites)
+		{
+			sprite->setPosition(sprite->getPosition() + Vec2(offset, offset));
+		}
+	}
+
+	// 绘制一帧，返回是否交换了缓冲
+	// 切换场景后的第一帧间隔为0，Director不绘制
+	bool draw_frame(Director *director, const RecordingGLView *view)
+	{
+		const uint64_t frames = view->get_frames();
+		director->drawScene();
+		PoolManager::getInstance()->getCurrentPool()->clear();
+		return view->get_frames() != frames;
+	}
+
+	uint64_t percentile(std::vector<uint64_t> &samples, double ratio)
+	{
+		if (samples.empty())
+		{
+			return 0;
+		}
+		size_t nth = static_cast<size_t>(ratio * (samples.size() - 1));
+		std::nth_element(samples.begin(), samples.begin() + nth, samples.end());
+		return samples[nth];
+	}
+
+	double to_ms(uint64_t ns)
+	{
+		return ns / 1e6;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	Options options;
+	if (!parse_options(argc, argv, options))
+	{
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	BenchmarkApp app;
+
+	auto director = Director::getInstance();
+	auto view = RecordingGLView::create(Size(kWidth, kHeight), options.persistent);
+	director->setOpenGLView(view);
+	view->setDesignResolutionSize(kWidth, kHeight, ResolutionPolicy::SHOW_ALL);
+	director->getRenderer()->setQuadReorderEnabled(options.reorder);
+
+	std::vector<Texture2D *> textures;
+	for (int i = 0; i < options.textures; ++i)
+	{
+		textures.push_back(create_texture(i));
+	}
+
+	FrameTimes times;
+	auto dispatcher = director->getEventDispatcher();
+	dispatcher->addCustomEventListener(Director::EVENT_AFTER_VISIT, [&times](EventCustom *)
+	{
+		times.after_visit = Clock::now();
+	});
+	dispatcher->addCustomEventListener(Director::EVENT_AFTER_DRAW, [&times](EventCustom *)
+	{
+		times.after_draw = Clock::now();
+	});
+
+	printf("textures: %d, static: %s, moving: %s, persistent: %s, reorder: %s, frames: %d\n",
+		options.textures,
+		options.static_batch ? "yes" : "no",
+		options.moving ? "yes" : "no",
+		options.persistent ? "yes" : "no",
+		options.reorder ? "yes" : "no",
+		options.frames);
+	printf("%8s %9s %9s %9s %9s %9s %9s %7s %7s %7s %7s %9s %8s\n",
+		"sprites", "frame ms", "p50 ms", "p99 ms", "visit ms", "render ms",
+		"gl calls", "draws", "batches", "saved", "progs", "uniforms", "KB");
+
+	std::mt19937 rng(options.seed);
+	std::vector<Sprite *> sprites;
+	std::vector<uint64_t> latencies;
+	for (int sprite_num : options.sprite_nums)
+	{
+		Scene *scene = create_scene(options, sprite_num, textures, rng, sprites);
+		if (director->getRunningScene() == nullptr)
+		{
+			director->runWithScene(scene);
+		}
+		else
+		{
+			director->replaceScene(scene);
+		}
+
+		uint64_t frame = 0;
+		for (int i = 0; i < options.warmup; ++i)
+		{
+			if (options.moving)
+			{
+				move_sprites(sprites, frame++);
+			}
+			draw_frame(director, view);
+		}
+
+		latencies.clear();
+		uint64_t total_ns = 0;
+		uint64_t visit_ns = 0;
+		uint64_t render_ns = 0;
+		uint64_t batches = 0;
+		uint64_t saved_batches = 0;
+		NullGLStats gl;
+		int done = 0;
+		while (done < options.frames)
+		{
+			if (options.moving)
+			{
+				move_sprites(sprites, frame++);
+			}
+
+			const NullGLStats before = null_gl_stats();
+			Clock::time_point begin = Clock::now();
+			const bool drawn = draw_frame(director, view);
+			Clock::time_point end = Clock::now();
+			if (!drawn)
+			{
+				continue;
+			}
+
+			const NullGLStats diff = null_gl_diff(null_gl_stats(), before);
+			gl.calls += diff.calls;
+			gl.draw_calls += diff.draw_calls;
+			gl.buffer_bytes += diff.buffer_bytes;
+			gl.program_binds += diff.program_binds;
+			gl.uniform_calls += diff.uniform_calls;
+
+			const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+			latencies.push_back(ns);
+			total_ns += ns;
+			visit_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(times.after_visit - begin).count();
+			render_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(times.after_draw - times.after_visit).count();
+			batches += director->getRenderer()->getDrawnBatches();
+			saved_batches += director->getRenderer()->getSavedBatches();
+			++done;
+		}
+
+		const double frames = done;
+		printf("%8d %9.3f %9.3f %9.3f %9.3f %9.3f %9.0f %7.0f %7.0f %7.0f %7.0f %9.0f %8.1f\n",
+			sprite_num,
+			to_ms(total_ns) / frames,
+			to_ms(percentile(latencies, 0.50)),
+			to_ms(percentile(latencies, 0.99)),
+			to_ms(visit_ns) / frames,
+			to_ms(render_ns) / frames,
+			gl.calls / frames,
+			gl.draw_calls / frames,
+			batches / frames,
+			saved_batches / frames,
+			gl.program_binds / frames,
+			gl.uniform_calls / frames,
+			gl.buffer_bytes / frames / 1024.0);
+	}
+
+	for (auto texture : textures)
+	{
+		texture->release();
+	}
+	return 0;
+}
@@ -0,0 +1,112 @@
+﻿/**
+ * 关卡打包工具
+ * 读取TMX关卡文件，把所有关卡的布局打包成一个关卡包
+ * 关卡编号取自文件名中的数字，如 map/07.tmx 为第7关
+ */
+
+#include <map>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include "LevelArchive.h"
+#include "tmx_reader.h"
+
+namespace
+{
+	void print_usage(const char *name)
+	{
+		printf("usage: %s -o OUTPUT FILE.tmx...\n", name);
+	}
+
+	// 从文件名中取出关卡编号
+	bool parse_level(const std::string &filename, uint32_t &ret)
+	{
+		const size_t slash = filename.find_last_of("/\\");
+		const std::string name = slash == std::string::npos ? filename : filename.substr(slash + 1);
+		char *end = nullptr;
+		const unsigned long level = strtoul(name.c_str(), &end, 10);
+		if (end == name.c_str() || strcmp(end, ".tmx") != 0)
+		{
+			return false;
+		}
+		ret = static_cast<uint32_t>(level);
+		return true;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	std::string output;
+	std::vector<std::string> files;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+		{
+			output = argv[++i];
+		}
+		else if (argv[i][0] != '-')
+		{
+			files.push_back(argv[i]);
+		}
+		else
+		{
+			print_usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (output.empty() || files.empty())
+	{
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	std::map<uint32_t, CheckerboardConfig> levels;
+	for (auto &filename : files)
+	{
+		uint32_t level = 0;
+		if (!parse_level(filename, level))
+		{
+			printf("%s: file name is not a level number\n", filename.c_str());
+			return 1;
+		}
+
+		CheckerboardConfig config;
+		if (!load_tmx_config(filename, config))
+		{
+			printf("%s: invalid level file\n", filename.c_str());
+			return 1;
+		}
+
+		if (!levels.insert(std::make_pair(level, config)).second)
+		{
+			printf("%s: duplicate level %u\n", filename.c_str(), level);
+			return 1;
+		}
+	}
+
+	std::vector<uint8_t> data;
+	if (!LevelArchive::build(levels, data))
+	{
+		printf("failed to pack levels, width must not exceed %d\n", LevelArchive::kMaxWidth);
+		return 1;
+	}
+
+	FILE *file = fopen(output.c_str(), "wb");
+	if (file == nullptr || fwrite(data.data(), 1, data.size(), file) != data.size())
+	{
+		printf("failed to write %s\n", output.c_str());
+		if (file != nullptr)
+		{
+			fclose(file);
+		}
+		return 1;
+	}
+	fclose(file);
+
+	printf("packed %zu levels (%zu bytes) to %s\n", levels.size(), data.size(), output.c_str());
+	return 0;
+}
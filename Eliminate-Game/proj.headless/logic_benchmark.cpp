@@ -0,0 +1,308 @@
+﻿/**
+ * 游戏逻辑吞吐量测试
+ * 在随机生成的棋盘上执行大量随机交换，统计每秒交换数、每秒连消数与单步延迟
+ */
+
+#include <chrono>
+#include <random>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <new>
+#include <algorithm>
+#include "Bitboard.h"
+#include "GameLogic.h"
+
+// 统计堆分配次数
+static uint64_t g_allocations = 0;
+
+void* operator new(size_t size)
+{
+	++g_allocations;
+	void *ptr = malloc(size > 0 ? size : 1);
+	if (ptr == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+	free(ptr);
+}
+
+namespace
+{
+	struct Options
+	{
+		uint64_t	moves;			// 交换次数
+		uint64_t	moves_per_board;// 每个棋盘的交换次数
+		int			min_size;		// 最小边长
+		int			max_size;		// 最大边长
+		int			min_types;		// 最少类型数量
+		int			max_types;		// 最多类型数量
+		int			hole_percent;	// 空洞比例
+		unsigned	seed;			// 随机种子
+
+		Options()
+			: moves(1000000)
+			, moves_per_board(10000)
+			, min_size(6)
+			, max_size(12)
+			, min_types(4)
+			, max_types(6)
+			, hole_percent(10)
+			, seed(1)
+		{
+		}
+	};
+
+	void print_usage(const char *name)
+	{
+		printf("usage: %s [--moves N] [--moves-per-board N] [--size MIN MAX] [--types MIN MAX] [--holes PERCENT] [--seed N]\n", name);
+	}
+
+	bool parse_options(int argc, char **argv, Options &options)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			const char *arg = argv[i];
+			if (strcmp(arg, "--moves") == 0 && i + 1 < argc)
+			{
+				options.moves = strtoull(argv[++i], nullptr, 10);
+			}
+			else if (strcmp(arg, "--moves-per-board") == 0 && i + 1 < argc)
+			{
+				options.moves_per_board = strtoull(argv[++i], nullptr, 10);
+			}
+			else if (strcmp(arg, "--size") == 0 && i + 2 < argc)
+			{
+				options.min_size = atoi(argv[++i]);
+				options.max_size = atoi(argv[++i]);
+			}
+			else if (strcmp(arg, "--types") == 0 && i + 2 < argc)
+			{
+				options.min_types = atoi(argv[++i]);
+				options.max_types = atoi(argv[++i]);
+			}
+			else if (strcmp(arg, "--holes") == 0 && i + 1 < argc)
+			{
+				options.hole_percent = atoi(argv[++i]);
+			}
+			else if (strcmp(arg, "--seed") == 0 && i + 1 < argc)
+			{
+				options.seed = static_cast<unsigned>(strtoul(argv[++i], nullptr, 10));
+			}
+			else
+			{
+				return false;
+			}
+		}
+
+		return options.moves > 0
+			&& options.moves_per_board > 0
+			&& options.min_size >= 3 && options.max_size >= options.min_size
+			&& options.min_types >= 3 && options.max_types >= options.min_types
+			&& options.hole_percent >= 0 && options.hole_percent < 100;
+	}
+
+	// 生成随机棋盘，顶行保持完整以便生成新元素
+	CheckerboardConfig generate_config(const Options &options, std::mt19937 &rng)
+	{
+		std::uniform_int_distribution<int> size_dis(options.min_size, options.max_size);
+		std::uniform_int_distribution<int> type_dis(options.min_types, options.max_types);
+		std::uniform_int_distribution<int> hole_dis(0, 99);
+
+		CheckerboardConfig config;
+		config.width = size_dis(rng);
+		config.height = size_dis(rng);
+		config.type_num = type_dis(rng);
+		config.layout.assign(config.width * config.height, true);
+		for (int row = 0; row < config.height - 1; ++row)
+		{
+			for (int col = 0; col < config.width; ++col)
+			{
+				if (hole_dis(rng) < options.hole_percent)
+				{
+					config.layout[row * config.width + col] = false;
+				}
+			}
+		}
+		return config;
+	}
+
+	// 整盘三消检测耗时
+	uint64_t measure_match_scan(const GameLogic &logic, int type_num, int iterations)
+	{
+		typedef std::chrono::steady_clock Clock;
+
+		const int width = logic.get_checkerboard_width();
+		const int height = logic.get_checkerboard_height();
+		const std::vector<int> &checkerboard = logic.get_checkerboard();
+
+		Bitboard bitboard;
+		bitboard.reset(width, height, type_num);
+		for (size_t idx = 0; idx < checkerboard.size(); ++idx)
+		{
+			if (checkerboard[idx] > GameLogic::FloorType::NOELEMENT)
+			{
+				bitboard.set(idx % width, idx / width, checkerboard[idx]);
+			}
+		}
+
+		int found = 0;
+		std::vector<Bitboard::Line> matches(height);
+		Clock::time_point begin = Clock::now();
+		for (int i = 0; i < iterations; ++i)
+		{
+			found += bitboard.find_all_matches(&matches[0]) ? 1 : 0;
+		}
+		Clock::time_point end = Clock::now();
+		volatile int sink = found;
+		(void)sink;
+
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+	}
+
+	// 查找可交换位置耗时
+	uint64_t measure_move_scan(const GameLogic &logic, int iterations, bool all)
+	{
+		typedef std::chrono::steady_clock Clock;
+
+		size_t found = 0;
+		std::vector<GameLogic::MoveTrack> moves;
+		moves.reserve(Bitboard::kMaxSize * Bitboard::kMaxSize * 2);
+		Clock::time_point begin = Clock::now();
+		for (int i = 0; i < iterations; ++i)
+		{
+			found += all ? logic.find_legal_moves(moves) : (logic.has_legal_move() ? 1 : 0);
+		}
+		Clock::time_point end = Clock::now();
+		volatile size_t sink = found;
+		(void)sink;
+
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+	}
+
+	uint64_t percentile(std::vector<uint64_t> &samples, double ratio)
+	{
+		if (samples.empty())
+		{
+			return 0;
+		}
+		size_t nth = static_cast<size_t>(ratio * (samples.size() - 1));
+		std::nth_element(samples.begin(), samples.begin() + nth, samples.end());
+		return samples[nth];
+	}
+}
+
+int main(int argc, char **argv)
+{
+	Options options;
+	if (!parse_options(argc, argv, options))
+	{
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	typedef std::chrono::steady_clock Clock;
+
+	std::mt19937 rng(options.seed);
+	std::vector<uint64_t> latencies;
+	latencies.reserve(static_cast<size_t>(options.moves));
+
+	uint64_t boards = 0;
+	uint64_t swaps = 0;
+	uint64_t cascades = 0;
+	uint64_t total_ns = 0;
+	uint64_t scan_ns = 0;
+	uint64_t scans = 0;
+	uint64_t find_moves_ns = 0;
+	uint64_t has_move_ns = 0;
+	uint64_t allocations = 0;
+	static const int kScanIterations = 10000;
+
+	static const int kOffsets[4][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+
+	uint64_t done = 0;
+	while (done < options.moves)
+	{
+		GameLogic logic;
+		CheckerboardConfig config = generate_config(options, rng);
+		logic.start_game(config, rng());
+		++boards;
+
+		std::uniform_int_distribution<int> col_dis(0, config.width - 1);
+		std::uniform_int_distribution<int> row_dis(0, config.height - 1);
+		std::uniform_int_distribution<int> dir_dis(0, 3);
+
+		const uint64_t board_moves = std::min(options.moves_per_board, options.moves - done);
+		for (uint64_t i = 0; i < board_moves; ++i)
+		{
+			// 丢弃上一步的动作
+			while (logic.get_action_group_num() > 0)
+			{
+				auto group = logic.take_action_group_from_queue();
+				if (!group.empty() && group.front().type == GameLogic::ActionType::REMOVE)
+				{
+					++cascades;
+				}
+			}
+
+			const int *offset = kOffsets[dir_dis(rng)];
+			GameLogic::Vec2 a(col_dis(rng), row_dis(rng));
+			GameLogic::Vec2 b(a.x + offset[0], a.y + offset[1]);
+
+			const uint64_t allocations_before = g_allocations;
+			Clock::time_point begin = Clock::now();
+			const bool success = logic.swap_and_eliminate(a, b);
+			Clock::time_point end = Clock::now();
+			allocations += g_allocations - allocations_before;
+
+			const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+			latencies.push_back(ns);
+			total_ns += ns;
+			if (success)
+			{
+				++swaps;
+			}
+		}
+
+		while (logic.get_action_group_num() > 0)
+		{
+			auto group = logic.take_action_group_from_queue();
+			if (!group.empty() && group.front().type == GameLogic::ActionType::REMOVE)
+			{
+				++cascades;
+			}
+		}
+
+		scan_ns += measure_match_scan(logic, config.type_num, kScanIterations);
+		find_moves_ns += measure_move_scan(logic, kScanIterations, true);
+		has_move_ns += measure_move_scan(logic, kScanIterations, false);
+		scans += kScanIterations;
+
+		done += board_moves;
+	}
+
+	const double seconds = total_ns / 1e9;
+	printf("boards:          %llu\n", static_cast<unsigned long long>(boards));
+	printf("moves:           %llu\n", static_cast<unsigned long long>(done));
+	printf("swaps:           %llu\n", static_cast<unsigned long long>(swaps));
+	printf("cascades:        %llu\n", static_cast<unsigned long long>(cascades));
+	printf("time:            %.3f s\n", seconds);
+	printf("moves/sec:       %.0f\n", seconds > 0 ? done / seconds : 0.0);
+	printf("swaps/sec:       %.0f\n", seconds > 0 ? swaps / seconds : 0.0);
+	printf("cascades/sec:    %.0f\n", seconds > 0 ? cascades / seconds : 0.0);
+	printf("p50 move:        %llu ns\n", static_cast<unsigned long long>(percentile(latencies, 0.50)));
+	printf("p99 move:        %llu ns\n", static_cast<unsigned long long>(percentile(latencies, 0.99)));
+	printf("allocs/move:     %.4f\n", done > 0 ? static_cast<double>(allocations) / done : 0.0);
+	printf("board scan:      %.1f ns\n", scans > 0 ? static_cast<double>(scan_ns) / scans : 0.0);
+	printf("find moves:      %.1f ns\n", scans > 0 ? static_cast<double>(find_moves_ns) / scans : 0.0);
+	printf("has move:        %.1f ns\n", scans > 0 ? static_cast<double>(has_move_ns) / scans : 0.0);
+
+	return 0;
+}
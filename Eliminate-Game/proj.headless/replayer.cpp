@@ -0,0 +1,292 @@
+﻿/**
+ * 对局回放工具
+ * 按记录的种子与交换序列重放对局，校验得分与结束时的棋盘；也可以生成随机对局用于测试
+ */
+
+#include <map>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include "Random.h"
+#include "Replay.h"
+#include "GameLogic.h"
+#include "LevelArchive.h"
+#include "ReplayValidator.h"
+#include "tmx_reader.h"
+
+#ifndef DEFAULT_LEVEL_DIR
+#define DEFAULT_LEVEL_DIR "Resources/map"
+#endif
+
+namespace
+{
+	struct Options
+	{
+		std::string					levels;			// 关卡目录或关卡包
+		std::string					record;			// 生成对局的输出文件
+		unsigned int				level;			// 生成对局的关卡
+		unsigned int				games;			// 生成对局数量
+		unsigned int				moves;			// 每局交换次数
+		uint64_t					seed;			// 随机种子
+		unsigned int				threads;		// 校验线程数量，0为硬件线程数
+		bool						dump;			// 输出动作序列
+		std::vector<std::string>	files;			// 回放文件
+
+		Options()
+			: levels(DEFAULT_LEVEL_DIR)
+			, level(1)
+			, games(100)
+			, moves(200)
+			, seed(1)
+			, threads(0)
+			, dump(false)
+		{
+		}
+	};
+
+	void print_usage(const char *name)
+	{
+		printf("usage: %s [--levels DIR|ARCHIVE] [--threads N] [--dump] FILE...\n", name);
+		printf("       %s --record FILE [--levels DIR|ARCHIVE] [--level N] [--games N] [--moves N] [--seed N]\n", name);
+	}
+
+	bool parse_options(int argc, char **argv, Options &options)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			const char *arg = argv[i];
+			if (strcmp(arg, "--levels") == 0 && i + 1 < argc)
+			{
+				options.levels = argv[++i];
+			}
+			else if (strcmp(arg, "--record") == 0 && i + 1 < argc)
+			{
+				options.record = argv[++i];
+			}
+			else if (strcmp(arg, "--level") == 0 && i + 1 < argc)
+			{
+				options.level = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
+			}
+			else if (strcmp(arg, "--games") == 0 && i + 1 < argc)
+			{
+				options.games = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
+			}
+			else if (strcmp(arg, "--moves") == 0 && i + 1 < argc)
+			{
+				options.moves = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
+			}
+			else if (strcmp(arg, "--seed") == 0 && i + 1 < argc)
+			{
+				options.seed = strtoull(argv[++i], nullptr, 10);
+			}
+			else if (strcmp(arg, "--threads") == 0 && i + 1 < argc)
+			{
+				options.threads = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
+			}
+			else if (strcmp(arg, "--dump") == 0)
+			{
+				options.dump = true;
+			}
+			else if (arg[0] != '-')
+			{
+				options.files.push_back(arg);
+			}
+			else
+			{
+				return false;
+			}
+		}
+
+		return options.record.empty() ? !options.files.empty() : options.files.empty();
+	}
+
+	// 关卡来源，关卡包可以打开时从关卡包读取，否则作为目录读取TMX文件
+	struct Levels
+	{
+		std::string									path;
+		LevelArchive								archive;
+		std::map<unsigned int, CheckerboardConfig>	cache;
+
+		explicit Levels(const std::string &_path)
+			: path(_path)
+		{
+			archive.open(path);
+		}
+	};
+
+	// 按编号读取关卡，读过的关卡缓存起来
+	const CheckerboardConfig* get_level(Levels &levels, unsigned int level)
+	{
+		auto itr = levels.cache.find(level);
+		if (itr == levels.cache.end())
+		{
+			CheckerboardConfig config;
+			LevelArchive::Level view;
+			if (levels.archive.find_level(level, view))
+			{
+				view.to_config(config);
+			}
+			else if (levels.archive.level_num() > 0 || !load_tmx_config(level_filename(levels.path, level), config))
+			{
+				return nullptr;
+			}
+			itr = levels.cache.insert(std::make_pair(level, config)).first;
+		}
+		return &itr->second;
+	}
+
+	void dump_action_group(const GameLogic::ActionGroup &group)
+	{
+		static const char *kNames[] = { "NONE", "START", "MOVE", "REMOVE", "GENERATE", "AUTOFILL", "RESHUFFLE" };
+		printf("  group %zu\n", group.size());
+		for (auto &action : group)
+		{
+			printf("    %-8s type=%d (%d,%d) -> (%d,%d)\n", kNames[static_cast<int>(action.type)], action.element_type,
+				   action.source.x, action.source.y, action.target.x, action.target.y);
+		}
+	}
+
+	// 生成随机对局
+	int record(const Options &options)
+	{
+		Levels levels(options.levels);
+		const CheckerboardConfig *config = get_level(levels, options.level);
+		if (config == nullptr)
+		{
+			printf("failed to load level %u from %s\n", options.level, options.levels.c_str());
+			return 1;
+		}
+
+		Random random(options.seed);
+		std::vector<uint8_t> data;
+		GameLogic logic;
+		Replay replay;
+		for (unsigned int game = 0; game < options.games; ++game)
+		{
+			const uint64_t seed = (static_cast<uint64_t>(random.next()) << 32) | random.next();
+			replay.reset(options.level, seed);
+			logic.start_game(*config, seed);
+
+			for (unsigned int move = 0; move < options.moves; ++move)
+			{
+				while (logic.get_action_group_num() > 0)
+				{
+					logic.take_action_group_from_queue();
+				}
+
+				GameLogic::Vec2 a(random.next_int(0, config->width - 1), random.next_int(0, config->height - 1));
+				GameLogic::Vec2 b = a;
+				(random.next() & 1) ? (b.x += 1) : (b.y += 1);
+				if (logic.is_valid_element(a) && logic.is_valid_element(b))
+				{
+					replay.add_swap(a, b, config->width);
+					logic.swap_and_eliminate(a, b);
+				}
+			}
+
+			replay.set_result(logic.get_score(), Replay::checkerboard_checksum(logic.get_checkerboard()));
+			replay.serialize(data);
+		}
+
+		FILE *file = fopen(options.record.c_str(), "wb");
+		if (file == nullptr || fwrite(data.data(), 1, data.size(), file) != data.size())
+		{
+			printf("failed to write %s\n", options.record.c_str());
+			if (file != nullptr)
+			{
+				fclose(file);
+			}
+			return 1;
+		}
+		fclose(file);
+
+		printf("recorded %u games (%zu bytes) to %s\n", options.games, data.size(), options.record.c_str());
+		return 0;
+	}
+
+	// 逐个重放并输出动作序列
+	int dump(const Options &options, const std::vector<Replay> &replays)
+	{
+		Levels levels(options.levels);
+		unsigned int failed = 0;
+		GameLogic logic;
+		for (size_t i = 0; i < replays.size(); ++i)
+		{
+			const Replay &replay = replays[i];
+			const CheckerboardConfig *config = get_level(levels, replay.level());
+			printf("#%zu: level %u seed %llu\n", i, replay.level(), static_cast<unsigned long long>(replay.seed()));
+			if (config == nullptr || !replay.play(logic, *config, dump_action_group))
+			{
+				printf("#%zu: failed\n", i);
+				++failed;
+			}
+		}
+		return failed == 0 ? 0 : 2;
+	}
+
+	// 校验对局
+	int validate(const Options &options)
+	{
+		std::vector<Replay> replays;
+		for (auto &filename : options.files)
+		{
+			if (!Replay::load_from_file(filename, replays))
+			{
+				printf("%s: invalid replay file\n", filename.c_str());
+				return 1;
+			}
+		}
+
+		if (options.dump)
+		{
+			return dump(options, replays);
+		}
+
+		typedef std::chrono::steady_clock Clock;
+
+		Levels levels(options.levels);
+		ReplayValidator validator(options.threads);
+		std::vector<ReplayValidator::Result> results;
+		Clock::time_point begin = Clock::now();
+		const size_t passed = validator.validate(replays, [&](uint32_t level)
+		{
+			return get_level(levels, level);
+		}, results);
+		Clock::time_point end = Clock::now();
+
+		static const char *kStatus[] = { "passed", "mismatch", "unknown level", "invalid move" };
+		for (size_t i = 0; i < results.size(); ++i)
+		{
+			if (results[i].status != ReplayValidator::Status::PASSED)
+			{
+				printf("#%zu: %s, score %u (recorded %u)\n", i, kStatus[static_cast<int>(results[i].status)],
+					   results[i].score, replays[i].score());
+			}
+		}
+
+		const double seconds = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count() / 1e9;
+		printf("threads:   %zu\n", validator.thread_num());
+		printf("games:     %zu\n", replays.size());
+		printf("passed:    %zu\n", passed);
+		printf("failed:    %zu\n", replays.size() - passed);
+		printf("time:      %.3f s\n", seconds);
+		printf("games/sec: %.0f\n", seconds > 0 ? replays.size() / seconds : 0.0);
+		return passed == replays.size() ? 0 : 2;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	Options options;
+	if (!parse_options(argc, argv, options))
+	{
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	return options.record.empty() ? validate(options) : record(options);
+}
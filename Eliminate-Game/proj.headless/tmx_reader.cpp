@@ -0,0 +1,187 @@
+﻿#include "tmx_reader.h"
+
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <zlib.h>
+
+namespace
+{
+	bool read_file(const std::string &filename, std::string &ret)
+	{
+		FILE *file = fopen(filename.c_str(), "rb");
+		if (file == nullptr)
+		{
+			return false;
+		}
+
+		char buffer[4096];
+		size_t bytes = 0;
+		while ((bytes = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		{
+			ret.append(buffer, bytes);
+		}
+		fclose(file);
+		return true;
+	}
+
+	// 读取标签属性
+	bool get_attribute(const std::string &text, size_t tag, const char *name, std::string &ret)
+	{
+		const size_t end = text.find('>', tag);
+		const std::string key = std::string(" ") + name + "=\"";
+		const size_t pos = text.find(key, tag);
+		if (pos == std::string::npos || pos > end)
+		{
+			return false;
+		}
+
+		const size_t begin = pos + key.size();
+		const size_t quote = text.find('"', begin);
+		if (quote == std::string::npos)
+		{
+			return false;
+		}
+		ret = text.substr(begin, quote - begin);
+		return true;
+	}
+
+	bool decode_base64(const std::string &text, std::vector<uint8_t> &ret)
+	{
+		static const char kTable[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+		uint32_t value = 0;
+		int bits = 0;
+		for (char c : text)
+		{
+			if (c == '=' || c == ' ' || c == '\r' || c == '\n' || c == '\t')
+			{
+				continue;
+			}
+
+			const char *pos = strchr(kTable, c);
+			if (pos == nullptr || c == '\0')
+			{
+				return false;
+			}
+
+			value = (value << 6) | static_cast<uint32_t>(pos - kTable);
+			bits += 6;
+			if (bits >= 8)
+			{
+				bits -= 8;
+				ret.push_back(static_cast<uint8_t>(value >> bits));
+			}
+		}
+		return true;
+	}
+
+	bool inflate_data(const std::vector<uint8_t> &data, size_t size, std::vector<uint8_t> &ret)
+	{
+		ret.resize(size);
+
+		z_stream stream;
+		memset(&stream, 0, sizeof(stream));
+		// 自动识别zlib与gzip头
+		if (inflateInit2(&stream, 15 + 32) != Z_OK)
+		{
+			return false;
+		}
+
+		stream.next_in = const_cast<Bytef *>(data.data());
+		stream.avail_in = static_cast<uInt>(data.size());
+		stream.next_out = ret.data();
+		stream.avail_out = static_cast<uInt>(ret.size());
+		const int err = inflate(&stream, Z_FINISH);
+		const size_t out = stream.total_out;
+		inflateEnd(&stream);
+		return err == Z_STREAM_END && out == size;
+	}
+}
+
+// 读取TMX关卡
+bool load_tmx_config(const std::string &filename, CheckerboardConfig &ret)
+{
+	std::string text;
+	if (!read_file(filename, text))
+	{
+		return false;
+	}
+
+	// 只读取第一个图层，与CheckerboardCache一致
+	const size_t layer = text.find("<layer");
+	const size_t data = text.find("<data", layer);
+	if (layer == std::string::npos || data == std::string::npos)
+	{
+		return false;
+	}
+
+	std::string name, width, height, encoding, compression;
+	if (!get_attribute(text, layer, "name", name)
+		|| !get_attribute(text, layer, "width", width)
+		|| !get_attribute(text, layer, "height", height)
+		|| !get_attribute(text, data, "encoding", encoding)
+		|| encoding != "base64")
+	{
+		return false;
+	}
+	get_attribute(text, data, "compression", compression);
+
+	const size_t begin = text.find('>', data) + 1;
+	const size_t end = text.find("</data>", begin);
+	if (end == std::string::npos)
+	{
+		return false;
+	}
+
+	CheckerboardConfig config;
+	config.width = atoi(width.c_str());
+	config.height = atoi(height.c_str());
+	config.type_num = atoi(name.c_str());
+	if (config.width <= 0 || config.height <= 0)
+	{
+		return false;
+	}
+
+	std::vector<uint8_t> encoded, tiles;
+	const size_t tiles_size = config.width * config.height * sizeof(uint32_t);
+	if (!decode_base64(text.substr(begin, end - begin), encoded))
+	{
+		return false;
+	}
+	if (compression.empty())
+	{
+		tiles.swap(encoded);
+	}
+	else if ((compression != "zlib" && compression != "gzip") || !inflate_data(encoded, tiles_size, tiles))
+	{
+		return false;
+	}
+	if (tiles.size() != tiles_size)
+	{
+		return false;
+	}
+
+	// 坐标系转换，TMX第一行在最上方
+	config.layout.resize(config.width * config.height);
+	for (int row = 0; row < config.height; ++row)
+	{
+		for (int col = 0; col < config.width; ++col)
+		{
+			const uint8_t *tile = &tiles[((config.height - row - 1) * config.width + col) * sizeof(uint32_t)];
+			config.layout[row * config.width + col] = (tile[0] | tile[1] | tile[2] | tile[3]) != 0;
+		}
+	}
+
+	ret = config;
+	return true;
+}
+
+// 关卡文件名
+std::string level_filename(const std::string &dir, unsigned int level)
+{
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%02u.tmx", level);
+	return dir.empty() ? buffer : dir + "/" + buffer;
+}
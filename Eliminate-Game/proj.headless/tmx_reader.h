@@ -0,0 +1,24 @@
+﻿/**
+ * 关卡读取
+ * 不依赖引擎解析TMX关卡文件，与CheckerboardCache得到相同的棋盘配置
+ */
+
+#ifndef __TMX_READER_H__
+#define __TMX_READER_H__
+
+#include <string>
+#include "CheckerboardConfig.h"
+
+/**
+ * 读取TMX关卡
+ * 支持base64编码，无压缩或zlib/gzip压缩的图层数据
+ */
+bool load_tmx_config(const std::string &filename, CheckerboardConfig &ret);
+
+/**
+ * 关卡文件名
+ * 关卡编号对应 <dir>/<编号两位数>.tmx
+ */
+std::string level_filename(const std::string &dir, unsigned int level);
+
+#endif